@@ -1,10 +1,23 @@
 #include <algorithm>
 #include <bits/types/wint_t.h>
 #include <cctype>
+#include <cerrno>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <linux/limits.h>
-#include <sys/select.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 #include <cstdlib>
 #include <cstdlib>
@@ -17,6 +30,18 @@
 #include <limits.h>
 #include <iostream>
 #include <chrono>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <set>
+#include <tuple>
+#include <functional>
+#include <memory>
 
 #define ctrl(x) (x & 0x1F)
 
@@ -35,6 +60,8 @@ struct VocInfo {
 	vector<string> en;
 	vector<string> ja;
 	vector<string> furi;
+	std::unordered_map<string, vector<int>> enIds; // normalized english translation -> vocabularies accepting it
+	std::unordered_map<string, vector<int>> jaIds; // normalized japanese notation or reading -> vocabularies accepting it
 };
 
 const string opt1 = "Japanese -> English";
@@ -43,7 +70,121 @@ const string opt3 = "Japanese <-> English";
 const string opt4 = "Dictionaries";
 const string opt5 = "Exit";
 
-int corUTrans = 0; // number of correct user translations
+/**
+ * xoshiro256** pseudo random number generator, seeded via splitmix64
+ */
+struct Rng {
+	uint64_t s[4];
+
+	void seed(uint64_t seed) {
+		for (int i=0;i<4;++i) {
+			uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			s[i] = z ^ (z >> 31);
+		}
+	}
+
+	uint64_t next() {
+		uint64_t result = rotl(s[1]*5, 7)*9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	/* unbiased number in [0,bound) (Lemire's multiply and reject) */
+	uint64_t below(uint64_t bound) {
+		__uint128_t m = (__uint128_t) next() * bound;
+		uint64_t low = (uint64_t) m;
+		if (low < bound) {
+			uint64_t threshold = -bound % bound;
+			while (low < threshold) {
+				m = (__uint128_t) next() * bound;
+				low = (uint64_t) m;
+			}
+		}
+		return m >> 64;
+	}
+
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64-k)); }
+};
+
+/**
+ * Fisher-Yates shuffle that draws one element at a time.
+ * Only positions that were swapped are stored, so every draw is O(1) and no
+ * index vector of the whole deck has to be built before the first card.
+ */
+struct LazyShuffle {
+	int size = 0;
+	int drawn = 0;
+	std::unordered_map<int,int> swapped; // position -> index, identity if absent
+
+	void reset(int n) { size = n; drawn = 0; swapped.clear(); }
+	bool done() const { return drawn >= size; }
+
+	int at(int pos) const {
+		auto it = swapped.find(pos);
+		return (it == swapped.end()) ? pos : it->second;
+	}
+
+	int next(Rng & rng) {
+		int j = drawn + rng.below(size-drawn);
+		int picked = at(j);
+		if (j != drawn) swapped[j] = at(drawn);
+		swapped.erase(drawn); // position is never looked at again
+		++drawn;
+		return picked;
+	}
+};
+
+uint64_t sessionSeed; // seed of the next session, set by --seed or at random
+
+/**
+ * Removes surrounding white space
+ *
+ * @param text The text
+ * @return The text without leading and trailing blanks
+ */
+string trim(const string & text) {
+	size_t start = text.find_first_not_of(" \t");
+	if (start == string::npos) return "";
+	return text.substr(start, text.find_last_not_of(" \t")-start+1);
+}
+
+/**
+ * Normalizes a translation for lookups in the answer indexes
+ *
+ * @param trans A single translation
+ * @return The translation in lower case without surrounding white space
+ */
+string normalizeAnswer(string trans) {
+	trans = trim(trans);
+	std::transform(trans.begin(),trans.end(),trans.begin(),::tolower); // to lower case
+	return trans;
+}
+
+/**
+ * Adds all translations of one vocabulary to an answer index
+ *
+ * @param index The answer index
+ * @param trans Translations separated by semicolons
+ * @param id Index of the vocabulary
+ */
+void indexAnswers(std::unordered_map<string, vector<int>> & index, const string & trans, int id) {
+	size_t start = 0;
+	while (start <= trans.size()) {
+		size_t end = trans.find(';', start);
+		if (end == string::npos) end = trans.size();
+		string answer = normalizeAnswer(trans.substr(start, end-start));
+		if (!answer.empty()) {
+			vector<int> & ids = index[answer];
+			if ( ids.empty() || (ids.back() != id) ) ids.push_back(id);
+		}
+		start = end+1;
+	}
+}
 
 /**
  * Saves all vocs and their amount inside a struct
@@ -68,6 +209,12 @@ VocInfo getVocs(string dict) {
 	}
 	dictFile.close();
 	Vocs.vocNum = Vocs.en.size();
+	/* every answer is indexed once so wrong answers can be traced to the vocabulary they belong to */
+	for (int i=0; i<Vocs.vocNum; ++i) {
+		indexAnswers(Vocs.enIds, Vocs.en[i], i);
+		indexAnswers(Vocs.jaIds, Vocs.ja[i], i);
+		indexAnswers(Vocs.jaIds, Vocs.furi[i], i);
+	}
 	return Vocs;
 } 
 
@@ -128,7 +275,7 @@ vector<string> getRemTrans(string uTrans, string trans) {
 
 	if (isSubSet(uTrans, trans)) {
 		for (int i=0; i<vecUTrans.size();++i) {
-			for (int j=0; j<=vecTrans.size();++j) {
+			for (int j=0; j<vecTrans.size();++j) {
 				std::transform(vecUTrans[i].begin(),vecUTrans[i].end(),vecUTrans[i].begin(),::tolower); // to lower case
 				std::transform(vecTrans[j].begin(),vecTrans[j].end(),vecTrans[j].begin(),::tolower); // to lower case
 				if (vecUTrans[i] == vecTrans[j]) {
@@ -144,245 +291,1244 @@ vector<string> getRemTrans(string uTrans, string trans) {
 }
 
 /**
- * Creates a user input box around a given window
+ * Outcome of grading a single user translation
+ */
+struct Grade {
+	bool correct = false;
+	bool byReading = false; // en->ja translation matched the furigana instead of the kanji notation
+	vector<string> remTrans; // ja->en translations the user did not know
+	int confusedIdx = -1; // other vocabulary a wrong translation belongs to, -1 if there is none
+	string confusedWith; // the queried side of that vocabulary
+};
+
+/**
+ * Looks up whether a wrong translation is the translation of another vocabulary
  *
- * @param winName The window where the user input box is positioned
+ * @param Vocs Structure containing all vocabulary and their amount
+ * @param idx Index of the queried vocabulary
+ * @param jaToEn True if japanese was queried and english is expected, false for the opposite
+ * @param uTrans Translations entered by the user separated by semicolons
+ * @return Index of the other vocabulary or -1
  */
-void mkInputBox(WINDOW * winName) {
-	int left,right,top,bottom,tlc,trc,blc,brc;
-	top = left = right = tlc = trc = blc = brc = 23; //space
-	bottom = 0;
-	wborder(winName, left, right, top, bottom, tlc, trc, blc, brc);
-	wrefresh(winName);
+int findConfusion(const VocInfo & Vocs, int idx, bool jaToEn, const string & uTrans) {
+	const std::unordered_map<string, vector<int>> & index = (jaToEn) ? Vocs.enIds : Vocs.jaIds;
+	for (const string & trans : partitionAllTrans(uTrans)) {
+		auto it = index.find(normalizeAnswer(trans));
+		if (it == index.end()) continue;
+		for (int id : it->second) if (id != idx) return id;
+	}
+	return -1;
 }
 
-void mkRisingPoints(){
-	noecho(); curs_set(false);	
+/**
+ * Grades a user translation with the same rules as the interactive queries
+ *
+ * @param Vocs Structure containing all vocabulary and their amount
+ * @param idx Index of the queried vocabulary
+ * @param jaToEn True if japanese was queried and english is expected, false for the opposite
+ * @param uTrans Translations entered by the user separated by semicolons
+ * @return Whether the translation is correct and which translations remain
+ */
+Grade gradeAnswer(const VocInfo & Vocs, int idx, bool jaToEn, const string & uTrans) {
+	Grade grade;
+	if (jaToEn) {
+		grade.correct = isSubSet(uTrans, Vocs.en[idx]);
+		grade.remTrans = getRemTrans(uTrans, Vocs.en[idx]);
+	}
+	else if (isSubSet(uTrans, Vocs.ja[idx])) grade.correct = true;
+	else if ( isSubSet(uTrans, Vocs.furi[idx]) && (!Vocs.furi[idx].empty()) ) grade.correct = grade.byReading = true;
+	if (!grade.correct) {
+		grade.confusedIdx = findConfusion(Vocs, idx, jaToEn, uTrans);
+		if (grade.confusedIdx != -1) grade.confusedWith = (jaToEn) ? Vocs.ja[grade.confusedIdx] : Vocs.en[grade.confusedIdx];
+	}
+	return grade;
+}
+
+/**
+ * Thread pool in which every worker owns a task deque.
+ * Workers take tasks from the back of their own deque and steal from the front
+ * of the other deques once it runs dry.
+ */
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned threads) {
+		for (unsigned i=0; i<threads; ++i) queues.push_back(std::make_unique<WorkQueue>());
+		for (unsigned i=0; i<threads; ++i) workers.emplace_back(&ThreadPool::work, this, i);
+	}
 
-	string point = "1";
-	int y = 30;
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> guard(sleepLock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread & worker : workers) worker.join();
+	}
 
-	WINDOW * xp = newwin(10, 1, 20, 40);
-	refresh();
+	/* hands tasks to the workers in turn, stealing evens out uneven tasks */
+	void submit(std::function<void()> task) {
+		WorkQueue & queue = *queues[nextQueue++ % queues.size()];
+		{
+			std::lock_guard<std::mutex> guard(queue.lock);
+			queue.tasks.push_back(std::move(task));
+		}
+		{
+			std::lock_guard<std::mutex> guard(sleepLock);
+			++pending;
+		}
+		wake.notify_one();
+	}
 
-	init_pair(2, COLOR_GREEN, COLOR_BLACK);
-	wattron(xp,COLOR_PAIR(2));
-	while (y>21) {
-		--y;
-		wmove(xp, y, 1);
-		wprintw(xp,point.c_str());
-		wrefresh(xp);
-		wmove(xp, y, 0);
-		usleep(1E4);
-		wclrtoeol(xp);
+private:
+	struct WorkQueue {
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	vector<std::unique_ptr<WorkQueue>> queues;
+	vector<std::thread> workers;
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::atomic<int> pending{0}; // submitted tasks no worker has taken yet
+	unsigned nextQueue = 0;
+	bool stopping = false;
+
+	bool takeTask(unsigned self, std::function<void()> & task) {
+		for (unsigned i=0; i<queues.size(); ++i) {
+			WorkQueue & queue = *queues[(self+i) % queues.size()];
+			std::lock_guard<std::mutex> guard(queue.lock);
+			if (queue.tasks.empty()) continue;
+			if (i == 0) { task = std::move(queue.tasks.back()); queue.tasks.pop_back(); }
+			else { task = std::move(queue.tasks.front()); queue.tasks.pop_front(); }
+			--pending;
+			return true;
+		}
+		return false;
 	}
-	wattroff(xp,COLOR_PAIR(2));
-	wclear(xp);
-}
+
+	void work(unsigned self) {
+		std::function<void()> task;
+		while (true) {
+			if (takeTask(self, task)) {
+				task();
+				continue;
+			}
+			std::unique_lock<std::mutex> sleeping(sleepLock);
+			wake.wait(sleeping, [this]{ return stopping || (pending > 0); });
+			if (stopping && (pending == 0)) return;
+		}
+	}
+};
 
 /**
- * Queries the user for a single japanese to english translation
+ * Splits a line of the cursaryd protocol into its tab separated fields
  *
- * @param queries Window containing the japanese vocabulary that is to be translated by the user
- * @param reply Window containing information whether the user translation is correct or not 
- * @param uInput Window where the user enters his translation
- * @param Vocs Structure containing all vocabulary and their amount
- * @param idx Index of the vocabulary to be queried
- * @param curVoc Number of current vocabulary (to show how many words were queried so far)
- * @return Number which is -1 if ctrl(o) is pressed (go back to main menu) and 0 else
+ * @param line The line without line break
+ * @return All fields, including empty ones
  */
-int queryJaToEn(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userStats, VocInfo Vocs, int idx, int curVoc) {
-	curs_set(true); cbreak(); nonl(); noecho(); intrflush(stdscr, false); keypad(uInput, true);
-	refresh();
+vector<string> splitFields(const string & line) {
+	vector<string> fields;
+	size_t start = 0, end;
+	while ( (end = line.find('\t', start)) != string::npos ) {
+		fields.push_back(line.substr(start, end-start));
+		start = end+1;
+	}
+	fields.push_back(line.substr(start));
+	return fields;
+}
 
-	/* colors */
-	init_pair(1, COLOR_RED, COLOR_BLACK);
-	init_pair(2, COLOR_GREEN, COLOR_BLACK);
-	/* colors */
+/**
+ * One vocabulary as it is queried
+ */
+struct Card {
+	string en;
+	string ja;
+	string furi;
+	bool jaToEn; // japanese is shown and english expected
+};
 
-	int queriesWidth = 60;
-	int userStatsHeight = 6;
-	int userStatsWidth = 20;
-	int maxInputLen = 25;
-	char uTrans[maxInputLen];
-	std::fill(uTrans, uTrans+maxInputLen, 0);
-	bool isFuriVisible = false;
+/**
+ * A query session: the order of its cards and how well they were answered.
+ * It either runs on a dictionary loaded by this process or, if daemonFd is set,
+ * forwards every step to a session kept by cursaryd.
+ */
+struct Session {
+	int daemonFd = -1; // connection to cursaryd
+	string received; // bytes from cursaryd following the last reply
+	std::shared_ptr<const VocInfo> Vocs;
+	Rng rng; // source of all randomness of the session
+	LazyShuffle order;
+	int uOption = 0; // ja->en, en->ja or mixed
+	int idx = -1; // vocabulary waiting for an answer, -1 if there is none
+	bool jaToEn = true;
+	int vocNum = 0;
+	int answered = 0;
+	int corUTrans = 0; // number of correct user translations
+	vector<std::pair<int,int>> confusions; // queried vocabulary and the one its wrong translation belongs to
+
+	/**
+	 * Starts a session on a dictionary of this process
+	 *
+	 * @param deck The dictionary
+	 * @param option Query option selected by user (japanese to english, english to japanese or mixed)
+	 * @param seed Seed for the order of the cards and their directions
+	 */
+	void start(std::shared_ptr<const VocInfo> deck, int option, uint64_t seed) {
+		Vocs = std::move(deck);
+		uOption = option;
+		rng.seed(seed); // the same seed always yields the same session
+		order.reset(Vocs->vocNum);
+		vocNum = Vocs->vocNum;
+		answered = corUTrans = 0;
+		idx = -1;
+		confusions.clear();
+	}
 
-	/* print query */
-	string ja = Vocs.ja[idx];
-	string en = Vocs.en[idx];
-	string furi = Vocs.furi[idx];
-	wattron(queries,COLOR_PAIR(1));
-	mvwprintw(queries, 1, queriesWidth/2 - ja.length()/3, ja.c_str()); // divided by 6 because one ja char has a length of 3
-	wattroff(queries,COLOR_PAIR(1));
-	wrefresh(queries);
-	/* print query */
+	/**
+	 * Starts a session on cursaryd
+	 *
+	 * @param dictName Name of a dictionary file inside the dictionary folder of cursaryd
+	 * @param option Query option selected by user (japanese to english, english to japanese or mixed)
+	 * @param seed Seed for the order of the cards and their directions
+	 */
+	void start(const string & dictName, int option, uint64_t seed) {
+		vector<string> reply = request("OPEN\t"+dictName+"\t"+std::to_string(option)+"\t"+std::to_string(seed));
+		if ( (reply[0] != "DECK") || (reply.size() < 2) ) throw string("Unexpected reply from cursaryd.");
+		uOption = option;
+		vocNum = std::stoi(reply[1]);
+		answered = corUTrans = 0;
+		idx = -1;
+		confusions.clear();
+	}
 
+	/**
+	 * Draws the next card
+	 *
+	 * @param card Receives the card
+	 * @return False if all cards were queried
+	 */
+	bool next(Card & card) {
+		if (daemonFd != -1) {
+			vector<string> reply = request("NEXT");
+			if (reply[0] == "END") return false;
+			if ( (reply[0] != "CARD") || (reply.size() < 6) ) throw string("Unexpected reply from cursaryd.");
+			card = {reply[2], reply[3], reply[4], reply[1] == "1"};
+			idx = std::stoi(reply[5]);
+			return true;
+		}
+		if (order.done()) return false;
+		idx = order.next(rng);
+		jaToEn = (uOption == 0) || ( (uOption == 2) && (rng.below(2) == 0) ); // mixed picks a direction at random
+		card = {Vocs->en[idx], Vocs->ja[idx], Vocs->furi[idx], jaToEn};
+		return true;
+	}
 
-	wmove(uInput, 0, 1);
-	/* get user input */
-	for (int i=0;i<maxInputLen;++i) {
-		char u = wgetch(uInput);
-		if (u == 13) break;
-		else if (u == ctrl('o')) return -1;
-	
-		else if ( (int) u == ctrl(KEY_BACKSPACE) ) { 
-			if (i>0) {
-				wmove(uInput, 0, i);
-				wclrtoeol(uInput);
-				uTrans[i] = 0; // empty corresponding uTrans entry
-				i-=2;
-			}
+	/**
+	 * Grades the translation of the current card and counts it
+	 *
+	 * @param uTrans Translations entered by the user separated by semicolons
+	 * @return Whether the translation is correct and which translations remain
+	 */
+	Grade grade(string uTrans) {
+		Grade grade;
+		if (daemonFd != -1) {
+			std::replace(uTrans.begin(), uTrans.end(), '\t', ' ');
+			std::replace(uTrans.begin(), uTrans.end(), '\n', ' ');
+			vector<string> reply = request("ANSWER\t"+uTrans);
+			if ( (reply[0] != "GRADE") || (reply.size() < 7) ) throw string("Unexpected reply from cursaryd.");
+			grade.correct = (reply[1] == "1");
+			grade.byReading = (reply[2] == "1");
+			if (!reply[3].empty()) grade.remTrans = partitionAllTrans(reply[3]);
+			corUTrans = std::stoi(reply[4]);
+			grade.confusedWith = reply[5];
+			grade.confusedIdx = std::stoi(reply[6]);
 		}
-		
-		/* clear the whole line and delete all saved data in uTrans */
-		else if (u == ctrl('n')) {
-			wmove(uInput, 0, 0);
-			wclrtoeol(uInput);
-			wmove(uInput, 0, 1);
-			std::fill(uTrans, uTrans+maxInputLen, 0); // reset uTrans 
-			i = -1;
+		else {
+			grade = gradeAnswer(*Vocs, idx, jaToEn, uTrans);
+			if (grade.correct) ++corUTrans;
 		}
-		/* toggle furigana visibility */
-		else if (u == ctrl('f')) {
-			curs_set(false);
-			if (isFuriVisible) {
-				wattron(queries, A_INVIS);
-				isFuriVisible = false;
-			} else isFuriVisible = true;
-			(furi.empty()) ? : mvwprintw(queries, 0, queriesWidth/2-furi.length()/3-1, "[%s]",furi.c_str()); // only print if not empty
-			wattroff(queries, A_INVIS);
-			wrefresh(queries);
-			i -= 1;
+		if (grade.confusedIdx != -1) confusions.emplace_back(idx, grade.confusedIdx);
+		idx = -1;
+		++answered;
+		return grade;
+	}
+
+	/**
+	 * Sends a request to cursaryd and waits for its reply
+	 *
+	 * @param line The request without line break
+	 * @return Fields of the reply
+	 */
+	vector<string> request(const string & line) {
+		string out = line+"\n";
+		for (size_t sent = 0; sent < out.size();) {
+			ssize_t n = write(daemonFd, out.data()+sent, out.size()-sent);
+			if (n <= 0) throw string("Connection to cursaryd lost.");
+			sent += n;
 		}
-		else {
-			wrefresh(uInput);
-			curs_set(true);
-			uTrans[i] = u;
-			wprintw(uInput, "%c",u);
+		size_t end;
+		while ( (end = received.find('\n')) == string::npos ) {
+			char buf[4096];
+			ssize_t n = read(daemonFd, buf, sizeof(buf));
+			if (n <= 0) throw string("Connection to cursaryd lost.");
+			received.append(buf, n);
 		}
+		vector<string> reply = splitFields(received.substr(0, end));
+		received.erase(0, end+1);
+		if ( (reply[0] == "ERR") && (reply.size() > 1) ) throw reply[1];
+		return reply;
 	}
-	/* get user input */
+};
 
-	wclear(reply);
+int daemonFd = -1; // connection to cursaryd if sessions run there
 
-	/* getting all remaining translations and storing them in a string separated by semicolons */
-	string remainTrans;
-	string delim = ";";
-	vector<string> remTrans = getRemTrans(uTrans, en);
-	for (int i=0;i<remTrans.size();++i) (i==0) ? remainTrans += remTrans[i] : remainTrans += delim+remTrans[i];
-	/* getting all remaining translations and storing them in a string separated by semicolons */
+/**
+ * One example sentence with its translation
+ */
+struct Example {
+	string ja;
+	string en;
+};
 
-	/* if translation is correct */
-	if (isSubSet(uTrans, en)) {
-		++corUTrans;
-		wattron(reply, COLOR_PAIR(2));
-		box(reply, 0, 0);
-		wattroff(reply, COLOR_PAIR(2));
-		string remRply; // all remaining replies
-		int startReplyIdx; // index for where reply text in reply window shall start
-		(remTrans.size()>0) ? remRply = "also correct:" : remRply = "correct";
-		string totReply = remRply+" "+remainTrans;
-		startReplyIdx = queriesWidth/2-totReply.length()/2;
+/* layout of an example index file: header, sentences, hash buckets, postings */
+struct ExampleHeader {
+	char magic[8];
+	uint64_t corpusSize; // to notice a corpus that changed after indexing
+	uint32_t sentences;
+	uint32_t buckets; // power of two
+	uint64_t postings;
+};
+struct ExampleSentence {
+	uint64_t offset; // line inside the corpus file
+	uint32_t length;
+	uint32_t unused;
+};
+struct ExampleBucket {
+	uint64_t hash; // 0 for an empty bucket
+	uint32_t start; // first posting
+	uint32_t count;
+};
+const char exampleMagic[8] = {'C','S','R','Y','E','X','1','\0'};
 
-		/* checking if reply text fits inside of reply window and if not adjust reply text */
-		if (startReplyIdx < 1){ 
-			string lenAdjstRply = totReply.substr(0,queriesWidth-6)+"..."; // length adjusted string, as it otherwise would not fit in reply window
-			mvwprintw(reply, 2, 1, lenAdjstRply.c_str());   
-		} 
-		else {
-			mvwprintw(reply, 2, startReplyIdx, totReply.c_str());   
+/**
+ * Splits a corpus line into its japanese and english sentence.
+ * The first field containing non ASCII characters is taken as japanese and the
+ * first other field containing letters as english, so both Tatoeba pair dumps
+ * (id, text, id, text) and plain (english, japanese) files can be used.
+ *
+ * @param line Start of the line
+ * @param length Length of the line without line break
+ * @param example Receives both sentences
+ * @return True if the line holds a japanese and an english sentence
+ */
+bool splitExample(const char * line, size_t length, Example & example) {
+	example.ja.clear(); example.en.clear();
+	size_t start = 0;
+	while (start <= length) {
+		size_t end = start;
+		while ( (end < length) && (line[end] != '\t') ) ++end;
+		bool ascii = true, letters = false;
+		for (size_t i=start; i<end; ++i) {
+			if ((unsigned char) line[i] >= 0x80) ascii = false;
+			else if (isalpha((unsigned char) line[i])) letters = true;
 		}
-		/* checking if reply text fits inside of reply window and if not adjust reply text */
-			
+		size_t fieldLength = end-start;
+		if ( (end > start) && (line[end-1] == '\r') ) --fieldLength;
+		if ( (!ascii) && example.ja.empty() ) example.ja.assign(line+start, fieldLength);
+		else if ( ascii && letters && example.en.empty() ) example.en.assign(line+start, fieldLength);
+		start = end+1;
 	}
-	/* if translation is correct */
-
-	/* if translation is false */
-	else {
-		wattron(reply, COLOR_PAIR(1));
-		box(reply, 0, 0);
-		wattroff(reply, COLOR_PAIR(1));
-		string jpReply; 
+	return (!example.ja.empty()) && (!example.en.empty());
+}
 
-		(furi.empty()) ? (jpReply = ja) : (jpReply = ja+" ["+furi+"]"); 
-		int jpReplyIdx = queriesWidth/2 - jpReply.length()/2;
-		wattron(reply, COLOR_PAIR(1));
-		mvwprintw(reply, 1, jpReplyIdx, jpReply.c_str());
-		wattroff(reply, COLOR_PAIR(1));
+uint64_t tokenHash(const string & token) {
+	uint64_t hash = 0xCBF29CE484222325ULL; // FNV-1a
+	for (unsigned char c : token) hash = (hash ^ c) * 0x100000001B3ULL;
+	return (hash == 0) ? 1 : hash; // 0 marks empty buckets
+}
 
-		int enReplyIdx = queriesWidth/2-remainTrans.length()/2;
-		/* checking if reply text fits inside of reply window and if not adjust reply text */
-		if (enReplyIdx < 1){ 
-			string lenAdjstRply = remainTrans.substr(0,queriesWidth-5)+"..."; // length adjusted string, as it otherwise would not fit in reply window
-			mvwprintw(reply, 3, 1, lenAdjstRply.c_str());   
-		} 
-		else {
-			mvwprintw(reply, 3, enReplyIdx, remainTrans.c_str());   
+/**
+ * Japanese tokens of a text: every kanji on its own and every pair of adjacent
+ * kana or kanji, as japanese is written without spaces
+ *
+ * @param text UTF-8 encoded japanese text
+ * @return Hashes of all tokens
+ */
+vector<uint64_t> jaTokens(const string & text) {
+	vector<uint64_t> tokens;
+	string prev; // previous character if it was kana or kanji
+	for (size_t i=0; i<text.size();) {
+		unsigned char c = text[i];
+		size_t len = (c < 0x80) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+		bool complete = (len <= text.size()-i);
+		for (size_t k=1; complete && (k<len); ++k) complete = ((text[i+k] & 0xC0) == 0x80);
+		if (!complete) { // cut off or invalid sequence
+			prev.clear();
+			++i;
+			continue;
 		}
-		/* checking if reply text fits inside of reply window and if not adjust reply text */
+		string ch = text.substr(i, len);
+		uint32_t code = 0;
+		if (len == 3) code = ((c & 0x0F) << 12) | ((text[i+1] & 0x3F) << 6) | (text[i+2] & 0x3F);
+		bool kana = (code >= 0x3040) && (code <= 0x30FF);
+		bool kanji = ( (code >= 0x4E00) && (code <= 0x9FFF) ) || ( (code >= 0x3400) && (code <= 0x4DBF) );
+		if (kanji) tokens.push_back(tokenHash("j:"+ch));
+		if ( (kana || kanji) && (!prev.empty()) ) tokens.push_back(tokenHash("j:"+prev+ch));
+		prev = (kana || kanji) ? ch : "";
+		i += len;
 	}
-	/* if translation is false */
-
-	wrefresh(reply);
-	wclear(queries);
-	refresh();
-	wmove(uInput, 0, 0); wclrtoeol(uInput);
-	if (*uTrans == ctrl('o')) return -1;
-
-	/* fill stats window */
-	/* box */
-	wattron(userStats, COLOR_PAIR(4));
-	box(userStats, 0, 0);
-	wattroff(userStats, COLOR_PAIR(4));
-	/* box */
-	/* header */
-	mvwprintw(userStats, 0, 2, "Statistics");
-	/* header */
-	string userStatsMessage = "Total: ";
-	wattron(userStats, COLOR_PAIR(2));
-	mvwprintw(userStats, userStatsHeight/2, userStatsWidth/2-1, "%d",corUTrans);
-	wattroff(userStats, COLOR_PAIR(2));
-	wprintw(userStats, "/");
-	wprintw(userStats, "%d",curVoc+1);
-	mvwprintw(userStats, userStatsHeight-1, 1, "%s%d",userStatsMessage.c_str(),Vocs.vocNum);
-	wrefresh(userStats);
-	/* fill stats window */
-
-	return 0;
+	return tokens;
 }
 
 /**
- * Queries the user for a single english to japanese translation
+ * English tokens of a text: its lower case words without very common ones
  *
- * @param queries Window containing the english vocabulary that is to be translated by the user
- * @param reply Window containing information whether the user translation is correct or not 
- * @param uInput Window where the user enters his translation
- * @param Vocs Structure containing all vocabulary and their amount
- * @param idx Index of the vocabulary to be queried
- * @param curVoc Number of current vocabulary (to show how many words were queried so far)
- * @return Number which is -1 if ctrl(o) is pressed (go back to main menu) and 0 else
+ * @param text English text
+ * @param words Receives the lower case words including the common ones
+ * @return Hashes of all tokens
  */
-int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userStats, VocInfo Vocs, int idx, int curVoc) {
-	curs_set(true); cbreak(); echo(); nonl(); intrflush(stdscr, false); keypad(uInput, true);
-	refresh();
-	
-	/* colors */
+vector<uint64_t> enTokens(const string & text, vector<string> & words) {
+	static const vector<string> common = {"a","an","the","to","of","is","it","be","in","on","i","you"};
+	vector<uint64_t> tokens;
+	words.clear();
+	string word;
+	for (size_t i=0; i<=text.size(); ++i) {
+		char c = (i < text.size()) ? ::tolower((unsigned char) text[i]) : ' ';
+		if ( isalnum((unsigned char) c) || (c == '\'') ) word += c;
+		else if (!word.empty()) {
+			words.push_back(word);
+			if (std::find(common.begin(), common.end(), word) == common.end()) tokens.push_back(tokenHash("e:"+word));
+			word.clear();
+		}
+	}
+	return tokens;
+}
+
+/**
+ * Example sentences of a corpus file, looked up through an inverted index from
+ * japanese and english tokens to sentences. Corpus and index are mapped into
+ * memory, so only the pages a lookup touches are ever read.
+ */
+struct ExampleIndex {
+	const char * corpus = nullptr;
+	size_t corpusSize = 0;
+	const char * index = nullptr;
+	size_t indexSize = 0;
+	const ExampleHeader * header = nullptr;
+	const ExampleSentence * sentences = nullptr;
+	const ExampleBucket * buckets = nullptr;
+	const uint32_t * postings = nullptr;
+
+	bool isOpen() const { return header != nullptr; }
+
+	static const char * mapFile(const string & name, size_t & size) {
+		int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd == -1) return nullptr;
+		struct stat info;
+		void * data = MAP_FAILED;
+		if ( (fstat(fd, &info) == 0) && (info.st_size > 0) ) {
+			size = info.st_size;
+			data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		}
+		::close(fd);
+		if (data == MAP_FAILED) return nullptr;
+		madvise(data, size, MADV_RANDOM);
+		return (const char *) data;
+	}
+
+	/**
+	 * Maps a corpus and its index file (corpus file name with ".idx" appended)
+	 *
+	 * @param corpusFile Name of the corpus file
+	 * @return Message explaining why the index can not be used, empty on success
+	 */
+	string open(const string & corpusFile) {
+		string error = mapFiles(corpusFile);
+		if (!error.empty()) close();
+		return error;
+	}
+
+	/* maps both files and checks that the tables of the index fit into it */
+	string mapFiles(const string & corpusFile) {
+		corpus = mapFile(corpusFile, corpusSize);
+		if (corpus == nullptr) return "File \""+corpusFile+"\" not found.";
+		index = mapFile(corpusFile+".idx", indexSize);
+		if (index == nullptr) return "File \""+corpusFile+".idx\" not found, create it with --build-examples.";
+		const ExampleHeader * head = (const ExampleHeader *) index;
+		if ( (indexSize < sizeof(ExampleHeader)) || (memcmp(head->magic, exampleMagic, 8) != 0) ) return "File \""+corpusFile+".idx\" is no example index.";
+		if (head->corpusSize != corpusSize) return "File \""+corpusFile+".idx\" is outdated, create it again with --build-examples.";
+		uint64_t tables = indexSize-sizeof(ExampleHeader);
+		uint64_t sentencesSize = (uint64_t) head->sentences*sizeof(ExampleSentence);
+		uint64_t bucketsSize = (uint64_t) head->buckets*sizeof(ExampleBucket);
+		bool fits = (head->buckets != 0) && ((head->buckets & (head->buckets-1)) == 0) // power of two
+			&& (sentencesSize+bucketsSize <= tables)
+			&& (head->postings <= (tables-sentencesSize-bucketsSize)/sizeof(uint32_t));
+		if (!fits) return "File \""+corpusFile+".idx\" is damaged, create it again with --build-examples.";
+		sentences = (const ExampleSentence *) (index+sizeof(ExampleHeader));
+		buckets = (const ExampleBucket *) (sentences+head->sentences);
+		postings = (const uint32_t *) (buckets+head->buckets);
+		header = head;
+		return "";
+	}
+
+	/* unmaps corpus and index */
+	void close() {
+		if (corpus != nullptr) munmap((void *) corpus, corpusSize);
+		if (index != nullptr) munmap((void *) index, indexSize);
+		corpus = index = nullptr;
+		corpusSize = indexSize = 0;
+		header = nullptr;
+	}
+
+	/* postings of a token, nullptr if no sentence contains it or the bucket points outside of the postings */
+	const ExampleBucket * find(uint64_t hash) const {
+		uint32_t mask = header->buckets-1;
+		for (uint32_t b = hash & mask, probes = 0; (buckets[b].hash != 0) && (probes < header->buckets); b = (b+1) & mask, ++probes) {
+			if (buckets[b].hash != hash) continue;
+			if ( (buckets[b].start > header->postings) || (buckets[b].count > header->postings-buckets[b].start) ) return nullptr;
+			return &buckets[b];
+		}
+		return nullptr;
+	}
+
+	/**
+	 * Reads a sentence pair of the corpus
+	 *
+	 * @param id Id of the sentence
+	 * @param example Receives the sentence pair
+	 * @return False if there is no such sentence or it has no translation
+	 */
+	bool sentence(uint32_t id, Example & example) const {
+		if (id >= header->sentences) return false;
+		const ExampleSentence & entry = sentences[id];
+		if ( (entry.offset > corpusSize) || (entry.length > corpusSize-entry.offset) ) return false;
+		return splitExample(corpus+entry.offset, entry.length, example);
+	}
+
+	/**
+	 * Adds sentences containing all tokens that pass a check
+	 *
+	 * @param tokens Hashes of the tokens
+	 * @param accept Checks a sentence, as tokens may match sentences not containing the word itself
+	 * @param want Number of sentences wanted in total
+	 * @param found Sentence ids found so far
+	 */
+	void search(vector<uint64_t> tokens, std::function<bool(const Example &)> accept, int want, vector<uint32_t> & found) const {
+		std::sort(tokens.begin(), tokens.end());
+		tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+		if ( tokens.empty() || (found.size() >= want) ) return;
+		vector<std::pair<const uint32_t *, const uint32_t *>> lists; // sorted posting lists
+		for (uint64_t hash : tokens) {
+			const ExampleBucket * bucket = find(hash);
+			if (bucket == nullptr) return;
+			lists.push_back({postings+bucket->start, postings+bucket->start+bucket->count});
+		}
+		std::sort(lists.begin(), lists.end(), [](auto & a, auto & b) { return a.second-a.first < b.second-b.first; });
+
+		const int maxChecks = 2048; // bounds the time of a lookup for very common tokens
+		int checks = 0;
+		Example example;
+		for (const uint32_t * id = lists[0].first; id != lists[0].second; ++id) {
+			bool inAll = true;
+			for (int l=1; (l<lists.size()) && inAll; ++l) {
+				lists[l].first = std::lower_bound(lists[l].first, lists[l].second, *id); // ids only grow
+				inAll = (lists[l].first != lists[l].second) && (*lists[l].first == *id);
+			}
+			if (!inAll) continue;
+			if (++checks > maxChecks) return;
+			if (std::find(found.begin(), found.end(), *id) != found.end()) continue;
+			if ( sentence(*id, example) && accept(example) ) {
+				found.push_back(*id);
+				if (found.size() >= want) return;
+			}
+		}
+	}
+
+	/**
+	 * Looks up example sentences for a vocabulary, preferring sentences containing the japanese word
+	 *
+	 * @param ja Japanese notation of the vocabulary
+	 * @param en English translations separated by semicolons
+	 * @param want Maximum number of examples
+	 * @return The examples
+	 */
+	vector<Example> lookup(const string & ja, const string & en, int want) const {
+		vector<Example> examples;
+		if (!isOpen()) return examples;
+		vector<uint32_t> found;
+		search(jaTokens(ja), [&](const Example & example) { return example.ja.find(ja) != string::npos; }, want, found);
+		for (const string & trans : partitionAllTrans(en)) {
+			vector<string> phrase, words;
+			vector<uint64_t> tokens = enTokens(trans, phrase); // empty for only common words
+			search(tokens, [&](const Example & example) {
+				enTokens(example.en, words);
+				return std::search(words.begin(), words.end(), phrase.begin(), phrase.end()) != words.end();
+			}, want, found);
+		}
+		for (uint32_t id : found) {
+			examples.emplace_back();
+			sentence(id, examples.back());
+		}
+		return examples;
+	}
+};
+
+ExampleIndex exampleIndex;
+
+const int keyTimeout = KEY_MAX+1; // time for the current answer ran out
+const int keyDrillOver = KEY_MAX+2; // time of the speed drill ran out
+
+/**
+ * Event loop polling stdin, a timerfd and a signalfd.
+ * Timers drive countdowns and animations, SIGWINCH becomes KEY_RESIZE and
+ * while nothing happens the program sleeps inside poll().
+ */
+struct EventLoop {
+	struct Timer {
+		int id;
+		int64_t deadline; // CLOCK_MONOTONIC nanoseconds
+		int64_t interval; // nanoseconds between expiries of repeating timers, 0 if it expires once
+		std::function<void()> expire;
+	};
+
+	int timerFd = -1;
+	int signalFd = -1;
+	int nextId = 0;
+	vector<Timer> timers; // only a handful are ever active
+	std::deque<int> posted; // keys posted by timers, returned before user input
+
+	void init() {
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGWINCH);
+		sigprocmask(SIG_BLOCK, &signals, nullptr); // delivered through signalFd instead
+		signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+		timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if ( (signalFd == -1) || (timerFd == -1) ) throw string("Could not create event loop.");
+	}
+
+	static int64_t now() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec*1000000000LL + ts.tv_nsec;
+	}
+
+	/**
+	 * Starts a timer
+	 *
+	 * @param ms Milliseconds until the timer expires
+	 * @param repeat Whether the timer expires again every ms milliseconds
+	 * @param expire Called on expiry from within getKey
+	 * @return Id of the timer
+	 */
+	int addTimer(int ms, bool repeat, std::function<void()> expire) {
+		int64_t interval = ms*1000000LL;
+		timers.push_back({nextId, now()+interval, (repeat) ? interval : 0, std::move(expire)});
+		arm();
+		return nextId++;
+	}
+
+	/* stops a timer and sets its id to -1, does nothing if the timer already expired */
+	void cancelTimer(int & id) {
+		for (int i=0; i<timers.size(); ++i) {
+			if (timers[i].id == id) {
+				timers.erase(timers.begin()+i);
+				arm();
+				break;
+			}
+		}
+		id = -1;
+	}
+
+	void post(int key) { posted.push_back(key); }
+
+	/* sets timerFd to the earliest deadline or disarms it if no timer is left */
+	void arm() {
+		itimerspec spec = {};
+		if (!timers.empty()) {
+			int64_t earliest = timers[0].deadline;
+			for (const Timer & timer : timers) earliest = std::min(earliest, timer.deadline);
+			spec.it_value.tv_sec = earliest/1000000000LL;
+			spec.it_value.tv_nsec = earliest%1000000000LL;
+		}
+		timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+	}
+
+	void expireTimers() {
+		uint64_t expirations;
+		while (read(timerFd, &expirations, sizeof(expirations)) > 0);
+		int64_t current = now();
+		vector<int> due; // callbacks may add or cancel timers, so only ids are collected
+		for (const Timer & timer : timers) if (timer.deadline <= current) due.push_back(timer.id);
+		for (int id : due) {
+			for (int i=0; i<timers.size(); ++i) {
+				if (timers[i].id != id) continue;
+				std::function<void()> expire = timers[i].expire;
+				if (timers[i].interval == 0) timers.erase(timers.begin()+i);
+				else while (timers[i].deadline <= current) timers[i].deadline += timers[i].interval; // skip missed frames
+				expire();
+				break;
+			}
+		}
+		arm();
+	}
+
+	/**
+	 * Waits for the next key while timers keep running
+	 *
+	 * @param win Window that receives the input and the cursor
+	 * @return The key, KEY_RESIZE after the terminal was resized or a key posted by a timer
+	 */
+	int getKey(WINDOW * win) {
+		nodelay(win, true);
+		int key = ERR;
+		while (key == ERR) {
+			if (!posted.empty()) {
+				key = posted.front();
+				posted.pop_front();
+				break;
+			}
+			key = wgetch(win);
+			if (key != ERR) break;
+
+			pollfd fds[3] = {{STDIN_FILENO, POLLIN, 0}, {timerFd, POLLIN, 0}, {signalFd, POLLIN, 0}};
+			if (poll(fds, 3, -1) == -1) continue;
+			if (fds[2].revents & POLLIN) {
+				signalfd_siginfo info;
+				while (read(signalFd, &info, sizeof(info)) > 0);
+				winsize size;
+				if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0) resizeterm(size.ws_row, size.ws_col);
+				key = KEY_RESIZE;
+			}
+			if (fds[1].revents & POLLIN) {
+				expireTimers();
+				wrefresh(win); // hand the cursor back to the input window
+			}
+		}
+		nodelay(win, false);
+		return key;
+	}
+};
+
+EventLoop events;
+
+/**
+ * Countdown shown in the lower right corner that posts a key once it runs out
+ */
+struct Countdown {
+	string label;
+	int expiryKey;
+	int64_t end = 0; // CLOCK_MONOTONIC nanoseconds, 0 while stopped
+	int timer = -1;
+};
+
+int answerSeconds = 0; // time limit for every answer, 0 for none
+int drillSeconds = 0; // time limit for a whole session, 0 for none
+Countdown answerClock = {"answer", keyTimeout};
+Countdown drillClock = {"drill", keyDrillOver};
+
+/**
+ * Shows the remaining seconds of all running countdowns
+ */
+void drawCountdowns() {
+	string text;
+	for (const Countdown * countdown : {&answerClock, &drillClock}) {
+		if (countdown->end == 0) continue;
+		int64_t left = std::max<int64_t>(0, countdown->end-EventLoop::now());
+		text += " "+countdown->label+" "+std::to_string((left+999999999LL)/1000000000LL)+"s ";
+	}
+	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
+	attron(COLOR_PAIR(3));
+	mvhline(maxY-1, maxX-26, ACS_HLINE, 24); // wipe the previous countdowns
+	mvprintw(maxY-1, maxX-2-text.length(), "%s", text.c_str());
+	attroff(COLOR_PAIR(3));
+	wnoutrefresh(stdscr);
+	doupdate();
+}
+
+/**
+ * Starts a countdown which ticks once a second
+ *
+ * @param countdown The countdown to start
+ * @param seconds Seconds until the countdown posts its expiry key
+ */
+void startCountdown(Countdown & countdown, int seconds) {
+	countdown.end = EventLoop::now()+seconds*1000000000LL;
+	countdown.timer = events.addTimer(1000, true, [&countdown]() {
+		if (EventLoop::now() >= countdown.end) {
+			events.cancelTimer(countdown.timer);
+			events.post(countdown.expiryKey);
+		}
+		drawCountdowns();
+	});
+	drawCountdowns();
+}
+
+void stopCountdown(Countdown & countdown) {
+	if (countdown.end == 0) return;
+	events.cancelTimer(countdown.timer);
+	countdown.end = 0;
+	drawCountdowns();
+}
+
+/**
+ * All windows of the program. They are created once and afterwards only moved and
+ * resized, their geometry is computed from the terminal size in layoutWindows.
+ */
+struct Layout {
+	WINDOW * title = nullptr;
+	WINDOW * opts = nullptr;
+	WINDOW * dictsSelect = nullptr;
+	WINDOW * queries = nullptr;
+	WINDOW * reply = nullptr;
+	WINDOW * userStats = nullptr;
+	WINDOW * points = nullptr;
+	WINDOW * results = nullptr;
+	WINDOW * uInput = nullptr;
+	WINDOW * examples = nullptr;
+
+	/* sizes that depend on the content of a window */
+	int titleWidth = 40;
+	int optsWidth = 27;
+	int dictsHeight = 5;
+	int examplesRows = 0; // free rows below the user input, the examples window is hidden if there are none
+};
+
+Layout layout;
+string sessionTitle; // query option shown in the frame of a session
+
+/**
+ * Creates a window or moves and resizes it in place, always keeping it inside the terminal
+ *
+ * @param win The window, nullptr if it does not exist yet
+ * @param height,width Size of the window
+ * @param y,x Position of the upper left corner
+ */
+void placeWindow(WINDOW *& win, int height, int width, int y, int x) {
+	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
+	height = std::max(1, std::min(height, maxY));
+	width = std::max(1, std::min(width, maxX));
+	y = std::max(0, std::min(y, maxY-height));
+	x = std::max(0, std::min(x, maxX-width));
+	if (win == nullptr) {
+		win = newwin(height, width, y, x);
+		return;
+	}
+	mvwin(win, 0, 0); // so resizing can not push the window off screen
+	wresize(win, height, width);
+	mvwin(win, y, x);
+}
+
+/**
+ * Computes the geometry of all windows from the terminal size and applies it
+ */
+void layoutWindows() {
+	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
+
+	/* start window */
+	int titleHeight = 5;
+	placeWindow(layout.title, titleHeight, layout.titleWidth, 2*maxY/5-titleHeight/2, maxX/2-layout.titleWidth/2);
+	/* start window */
+
+	/* options and dictionaries */
+	int optsHeight = 13;
+	placeWindow(layout.opts, optsHeight, layout.optsWidth, maxY/2-optsHeight, maxX/2-layout.optsWidth/2);
+	int dictSelectH = std::min(layout.dictsHeight, maxY/2);
+	int dictSelectW = 20;
+	placeWindow(layout.dictsSelect, dictSelectH, dictSelectW, maxY/2-dictSelectH, 2*maxX/3);
+	/* options and dictionaries */
+
+	/* query session, all windows inside the frame */
+	int userStatsHeight = 7; int userStatsWidth = 20;
+	int userStatsY = std::max(1, maxY/16); int userStatsX = maxX-1-userStatsWidth;
+	placeWindow(layout.userStats, userStatsHeight, userStatsWidth, userStatsY, userStatsX);
+	int pointsX = userStatsX-2;
+	placeWindow(layout.points, userStatsHeight, 1, userStatsY, pointsX); // left of the statistics
+	/* queries and replies are centered but keep clear of the points and statistics */
+	int queriesWidth = std::max(1, std::min(60, pointsX-3)); int replyWidth = queriesWidth;
+	int queriesX = std::max(2, std::min(maxX/2-queriesWidth/2, pointsX-1-queriesWidth));
+	int queriesHeight = 3;
+	placeWindow(layout.queries, queriesHeight, queriesWidth, maxY/4-queriesHeight/2, queriesX);
+	int replyHeight = 5;
+	placeWindow(layout.reply, replyHeight, replyWidth, 2*maxY/4-replyHeight/2, queriesX);
+	int resultsHeight = 12; int resultsWidth = 25;
+	placeWindow(layout.results, resultsHeight, resultsWidth, maxY/2-resultsHeight/2, maxX/2-resultsWidth/2);
+	int uInputHeight = 2; int uInputWidth = 30;
+	placeWindow(layout.uInput, uInputHeight, uInputWidth, 3*maxY/4-uInputHeight/2, (maxX-uInputWidth)/2);
+	int uInputY, uInputX; getbegyx(layout.uInput, uInputY, uInputX);
+	int examplesY = uInputY+uInputHeight; int examplesWidth = std::min(76, maxX-2);
+	layout.examplesRows = std::max(0, std::min(4, maxY-1-examplesY)); // above the bottom of the frame
+	placeWindow(layout.examples, std::max(1, layout.examplesRows), examplesWidth, examplesY, maxX/2-examplesWidth/2);
+	/* query session */
+}
+
+/**
+ * Deletes all windows
+ */
+void freeWindows() {
+	for (WINDOW ** win : {&layout.title, &layout.opts, &layout.dictsSelect, &layout.queries, &layout.reply,
+			&layout.userStats, &layout.points, &layout.results, &layout.uInput, &layout.examples}) {
+		if (*win != nullptr) delwin(*win);
+		*win = nullptr;
+	}
+}
+
+/**
+ * Draws the frame of a query session with the query option and the seed
+ */
+void drawSessionFrame() {
+	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
+	erase();
+	attron(COLOR_PAIR(3));
+	box(stdscr, 0, 0);
+	mvprintw(0, 2, sessionTitle.c_str());
+	attroff(COLOR_PAIR(3));
+	mvprintw(maxY-1, 2, "seed %llu", (unsigned long long) sessionSeed);
+	wnoutrefresh(stdscr);
+}
+
+/* example sentences need a corpus and room below the user input */
+bool examplesShown() {
+	return exampleIndex.isOpen() && (layout.examplesRows > 0);
+}
+
+/**
+ * Redraws a query session after the terminal was resized
+ */
+void redrawSession() {
+	layoutWindows();
+	drawSessionFrame();
+	for (WINDOW * win : {layout.queries, layout.reply, layout.userStats, layout.uInput, layout.examples}) {
+		if ( (win == layout.examples) && (!examplesShown()) ) continue;
+		touchwin(win);
+		wnoutrefresh(win);
+	}
+	drawCountdowns();
+}
+
+/**
+ * Cuts a UTF-8 string to the number of columns it may take up in the terminal
+ *
+ * @param text The string
+ * @param cols Available columns
+ * @return The longest beginning of text fitting into cols columns
+ */
+string fitColumns(const string & text, int cols) {
+	std::mbstate_t state = {};
+	size_t pos = 0;
+	while (pos < text.size()) {
+		wchar_t wc;
+		size_t len = mbrtowc(&wc, text.c_str()+pos, text.size()-pos, &state);
+		if ( (len == (size_t) -1) || (len == (size_t) -2) || (len == 0) ) break;
+		int width = std::max(0, wcwidth(wc));
+		if (width > cols) break;
+		cols -= width;
+		pos += len;
+	}
+	return text.substr(0, pos);
+}
+
+/**
+ * Tells in the reply window that a wrong translation belongs to another vocabulary
+ *
+ * @param reply Window containing information whether the user translation is correct or not
+ * @param replyWidth Width of the reply window
+ * @param word The queried side of the other vocabulary
+ */
+void printConfusion(WINDOW * reply, int replyWidth, const string & word) {
+	string confusion = "that's the answer for "+word;
+	string shown = fitColumns(confusion, replyWidth-2);
+	if (shown != confusion) shown = fitColumns(confusion, replyWidth-5)+"..."; // length adjusted string, as it otherwise would not fit in reply window
+	int columns = 0;
+	std::mbstate_t state = {};
+	for (size_t pos = 0, len; pos < shown.size(); pos += len) {
+		wchar_t wc;
+		len = mbrtowc(&wc, shown.c_str()+pos, shown.size()-pos, &state);
+		if ( (len == (size_t) -1) || (len == (size_t) -2) || (len == 0) ) break;
+		columns += std::max(0, wcwidth(wc));
+	}
+	mvwaddstr(reply, 2, replyWidth/2-columns/2, shown.c_str());
+}
+
+/**
+ * Shows example sentences of the replied vocabulary below the user input
+ *
+ * @param examples The example sentences
+ */
+void drawExamples(const vector<Example> & examples) {
+	if (!examplesShown()) return;
+	WINDOW * win = layout.examples;
+	int width = getmaxx(win);
+	werase(win);
+	for (int i=0; (i<examples.size()) && (2*i<layout.examplesRows); ++i) {
+		wattron(win, COLOR_PAIR(3));
+		mvwaddstr(win, 2*i, 0, fitColumns(examples[i].ja, width).c_str());
+		wattroff(win, COLOR_PAIR(3));
+		if (2*i+1 < layout.examplesRows) mvwaddstr(win, 2*i+1, 0, fitColumns(examples[i].en, width).c_str());
+	}
+	wrefresh(win);
+}
+
+/**
+ * Creates a user input box around a given window
+ *
+ * @param winName The window where the user input box is positioned
+ */
+void mkInputBox(WINDOW * winName) {
+	int left,right,top,bottom,tlc,trc,blc,brc;
+	top = left = right = tlc = trc = blc = brc = 23; //space
+	bottom = 0;
+	wborder(winName, left, right, top, bottom, tlc, trc, blc, brc);
+	wrefresh(winName);
+}
+
+/**
+ * Lets a green point rise next to the statistics, one frame every 10ms.
+ * The animation runs on a timer, so input is taken in the meantime.
+ */
+void mkRisingPoints(){
+	static int frame = -1; // timer of the running animation
+	static int y;
+	init_pair(2, COLOR_GREEN, COLOR_BLACK);
+
+	WINDOW * xp = layout.points;
+	events.cancelTimer(frame); // restart a running animation
+	y = getmaxy(xp);
+	frame = events.addTimer(10, true, [xp]() {
+		werase(xp);
+		if (--y < 0) {
+			wrefresh(xp);
+			events.cancelTimer(frame);
+			return;
+		}
+		wattron(xp,COLOR_PAIR(2));
+		mvwprintw(xp, y, 0, "1");
+		wattroff(xp,COLOR_PAIR(2));
+		wrefresh(xp);
+	});
+}
+
+/**
+ * Queries the user for a single japanese to english translation
+ *
+ * @param queries Window containing the japanese vocabulary that is to be translated by the user
+ * @param reply Window containing information whether the user translation is correct or not 
+ * @param uInput Window where the user enters his translation
+ * @param session Session the vocabulary belongs to
+ * @param card The vocabulary to be queried
+ * @param curVoc Number of current vocabulary (to show how many words were queried so far)
+ * @return Number which is -1 if ctrl(o) is pressed (go back to main menu) and 0 else
+ */
+int queryJaToEn(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userStats, Session & session, const Card & card, int curVoc) {
+	curs_set(true); cbreak(); nonl(); noecho(); intrflush(stdscr, false); keypad(uInput, true);
+	refresh();
+
+	/* colors */
 	init_pair(1, COLOR_RED, COLOR_BLACK);
 	init_pair(2, COLOR_GREEN, COLOR_BLACK);
 	/* colors */
 
-	int queriesWidth = 60;
+	int queriesWidth = getmaxx(queries);
 	int userStatsHeight = 6;
 	int userStatsWidth = 20;
 	int maxInputLen = 25;
 	char uTrans[maxInputLen];
 	std::fill(uTrans, uTrans+maxInputLen, 0);
+	bool isFuriVisible = false;
 
 	/* print query */
-	string en = Vocs.en[idx];
-	string ja = Vocs.ja[idx];
-	string furi = Vocs.furi[idx];
+	string ja = card.ja;
+	string en = card.en;
+	string furi = card.furi;
+	wattron(queries,COLOR_PAIR(1));
+	mvwprintw(queries, 1, queriesWidth/2 - ja.length()/3, ja.c_str()); // divided by 6 because one ja char has a length of 3
+	wattroff(queries,COLOR_PAIR(1));
+	wrefresh(queries);
+	/* print query */
+
+	vector<Example> examples = exampleIndex.lookup(ja, en, 2); // shown with the reply
+
+
+	wmove(uInput, 0, 1);
+	/* get user input */
+	for (int i=0;i<maxInputLen;++i) {
+		int key = events.getKey(uInput);
+		char u = key;
+		if ( (u == 13) || (key == keyTimeout) ) break;
+		else if (key == keyDrillOver) { // the drill ended before the card was answered
+			werase(queries); wrefresh(queries);
+			wmove(uInput, 0, 0); wclrtoeol(uInput); wrefresh(uInput);
+			return 1;
+		}
+		else if (key == KEY_RESIZE) {
+			redrawSession();
+			i -= 1;
+			continue;
+		}
+		else if (u == ctrl('o')) return -1;
+	
+		else if ( (int) u == ctrl(KEY_BACKSPACE) ) { 
+			if (i>0) {
+				wmove(uInput, 0, i);
+				wclrtoeol(uInput);
+				uTrans[i] = 0; // empty corresponding uTrans entry
+				i-=2;
+			}
+		}
+		
+		/* clear the whole line and delete all saved data in uTrans */
+		else if (u == ctrl('n')) {
+			wmove(uInput, 0, 0);
+			wclrtoeol(uInput);
+			wmove(uInput, 0, 1);
+			std::fill(uTrans, uTrans+maxInputLen, 0); // reset uTrans 
+			i = -1;
+		}
+		/* toggle furigana visibility */
+		else if (u == ctrl('f')) {
+			curs_set(false);
+			if (isFuriVisible) {
+				wattron(queries, A_INVIS);
+				isFuriVisible = false;
+			} else isFuriVisible = true;
+			(furi.empty()) ? : mvwprintw(queries, 0, queriesWidth/2-furi.length()/3-1, "[%s]",furi.c_str()); // only print if not empty
+			wattroff(queries, A_INVIS);
+			wrefresh(queries);
+			i -= 1;
+		}
+		else {
+			wrefresh(uInput);
+			curs_set(true);
+			uTrans[i] = u;
+			wprintw(uInput, "%c",u);
+		}
+	}
+	/* get user input */
+
+	wclear(reply);
+
+	/* getting all remaining translations and storing them in a string separated by semicolons */
+	string remainTrans;
+	string delim = ";";
+	Grade grade = session.grade(uTrans);
+	vector<string> & remTrans = grade.remTrans;
+	for (int i=0;i<remTrans.size();++i) (i==0) ? remainTrans += remTrans[i] : remainTrans += delim+remTrans[i];
+	/* getting all remaining translations and storing them in a string separated by semicolons */
+
+	/* if translation is correct */
+	if (grade.correct) {
+		mkRisingPoints();
+		wattron(reply, COLOR_PAIR(2));
+		box(reply, 0, 0);
+		wattroff(reply, COLOR_PAIR(2));
+		string remRply; // all remaining replies
+		int startReplyIdx; // index for where reply text in reply window shall start
+		(remTrans.size()>0) ? remRply = "also correct:" : remRply = "correct";
+		string totReply = remRply+" "+remainTrans;
+		startReplyIdx = queriesWidth/2-totReply.length()/2;
+
+		/* checking if reply text fits inside of reply window and if not adjust reply text */
+		if (startReplyIdx < 1){ 
+			string lenAdjstRply = totReply.substr(0,queriesWidth-6)+"..."; // length adjusted string, as it otherwise would not fit in reply window
+			mvwprintw(reply, 2, 1, lenAdjstRply.c_str());   
+		} 
+		else {
+			mvwprintw(reply, 2, startReplyIdx, totReply.c_str());   
+		}
+		/* checking if reply text fits inside of reply window and if not adjust reply text */
+			
+	}
+	/* if translation is correct */
+
+	/* if translation is false */
+	else {
+		wattron(reply, COLOR_PAIR(1));
+		box(reply, 0, 0);
+		wattroff(reply, COLOR_PAIR(1));
+		string jpReply; 
+
+		(furi.empty()) ? (jpReply = ja) : (jpReply = ja+" ["+furi+"]"); 
+		int jpReplyIdx = queriesWidth/2 - jpReply.length()/2;
+		wattron(reply, COLOR_PAIR(1));
+		mvwprintw(reply, 1, jpReplyIdx, jpReply.c_str());
+		wattroff(reply, COLOR_PAIR(1));
+
+		int enReplyIdx = queriesWidth/2-remainTrans.length()/2;
+		/* checking if reply text fits inside of reply window and if not adjust reply text */
+		if (enReplyIdx < 1){ 
+			string lenAdjstRply = remainTrans.substr(0,queriesWidth-5)+"..."; // length adjusted string, as it otherwise would not fit in reply window
+			mvwprintw(reply, 3, 1, lenAdjstRply.c_str());   
+		} 
+		else {
+			mvwprintw(reply, 3, enReplyIdx, remainTrans.c_str());   
+		}
+		/* checking if reply text fits inside of reply window and if not adjust reply text */
+
+		/* the translation belongs to another vocabulary */
+		if (!grade.confusedWith.empty()) printConfusion(reply, queriesWidth, grade.confusedWith);
+	}
+	/* if translation is false */
+
+	wrefresh(reply);
+	drawExamples(examples);
+	wclear(queries);
+	refresh();
+	wmove(uInput, 0, 0); wclrtoeol(uInput);
+	if (*uTrans == ctrl('o')) return -1;
+
+	/* fill stats window */
+	/* box */
+	wattron(userStats, COLOR_PAIR(4));
+	box(userStats, 0, 0);
+	wattroff(userStats, COLOR_PAIR(4));
+	/* box */
+	/* header */
+	mvwprintw(userStats, 0, 2, "Statistics");
+	/* header */
+	string userStatsMessage = "Total: ";
+	wattron(userStats, COLOR_PAIR(2));
+	mvwprintw(userStats, userStatsHeight/2, userStatsWidth/2-1, "%d",session.corUTrans);
+	wattroff(userStats, COLOR_PAIR(2));
+	wprintw(userStats, "/");
+	wprintw(userStats, "%d",curVoc+1);
+	mvwprintw(userStats, userStatsHeight-1, 1, "%s%d",userStatsMessage.c_str(),session.vocNum);
+	wrefresh(userStats);
+	/* fill stats window */
+
+	return 0;
+}
+
+/**
+ * Queries the user for a single english to japanese translation
+ *
+ * @param queries Window containing the english vocabulary that is to be translated by the user
+ * @param reply Window containing information whether the user translation is correct or not 
+ * @param uInput Window where the user enters his translation
+ * @param session Session the vocabulary belongs to
+ * @param card The vocabulary to be queried
+ * @param curVoc Number of current vocabulary (to show how many words were queried so far)
+ * @return Number which is -1 if ctrl(o) is pressed (go back to main menu) and 0 else
+ */
+int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userStats, Session & session, const Card & card, int curVoc) {
+	curs_set(true); cbreak(); echo(); nonl(); intrflush(stdscr, false); keypad(uInput, true);
+	refresh();
+	
+	/* colors */
+	init_pair(1, COLOR_RED, COLOR_BLACK);
+	init_pair(2, COLOR_GREEN, COLOR_BLACK);
+	/* colors */
+
+	int queriesWidth = getmaxx(queries);
+	int userStatsHeight = 6;
+	int userStatsWidth = 20;
+	int maxInputLen = 25;
+	char uTrans[maxInputLen];
+	std::fill(uTrans, uTrans+maxInputLen, 0);
+
+	/* print query */
+	string en = card.en;
+	string ja = card.ja;
+	string furi = card.furi;
 	wattron(queries,COLOR_PAIR(1));
 	//mvwprintw(queries, 1, queriesWidth/2-en.length()/2, en.c_str());
 	int startQryIdx = queriesWidth/2-en.length()/2;
@@ -400,12 +1546,25 @@ int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * user
 	wattroff(queries,COLOR_PAIR(1));
 	wrefresh(queries);
 	/* print query */
+
+	vector<Example> examples = exampleIndex.lookup(ja, en, 2); // shown with the reply
 	
 	wmove(uInput, 0, 1);
 	/* get user input */
 	for (int i=0;i<maxInputLen;++i) {
-		char u = wgetch(uInput);
-		if (u == 13) break;
+		int key = events.getKey(uInput);
+		char u = key;
+		if ( (u == 13) || (key == keyTimeout) ) break;
+		else if (key == keyDrillOver) { // the drill ended before the card was answered
+			werase(queries); wrefresh(queries);
+			wmove(uInput, 0, 0); wclrtoeol(uInput); wrefresh(uInput);
+			return 1;
+		}
+		else if (key == KEY_RESIZE) {
+			redrawSession();
+			i -= 1;
+			continue;
+		}
 		else if (u == ctrl('o')) return -1;
 		else if ((int) u == ctrl(KEY_BACKSPACE)) {
 			wmove(uInput, 0, 0);
@@ -428,16 +1587,17 @@ int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * user
 
 	wclear(reply);
 
-	if (isSubSet(uTrans, ja)) {
-		++corUTrans;
+	Grade grade = session.grade(uTrans);
+	if ( grade.correct && (!grade.byReading) ) {
+		mkRisingPoints();
 		string answer0 = "correct";
 		wattron(reply, COLOR_PAIR(2));
 		box(reply, 0, 0);
 		wattroff(reply, COLOR_PAIR(2));
 		mvwprintw(reply, 2, queriesWidth/2-answer0.length()/2, answer0.c_str());
 	}
-	else if ( isSubSet(uTrans, furi) && (!furi.empty()) ) {
-		++corUTrans;
+	else if (grade.correct) {
+		mkRisingPoints();
 		string kanjiExis = "kanji notation: ";
 		wattron(reply, COLOR_PAIR(2));
 		box(reply, 0, 0);
@@ -472,9 +1632,13 @@ int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * user
 		}
 		/* checking if reply text fits inside of reply window and if not adjust reply text */
 		wattroff(reply, COLOR_PAIR(1));
+
+		/* the translation belongs to another vocabulary */
+		if (!grade.confusedWith.empty()) printConfusion(reply, queriesWidth, grade.confusedWith);
 	}
 
 	wrefresh(reply);
+	drawExamples(examples);
 	wclear(queries);
 	refresh();
 	wmove(uInput, 0, 0); wclrtoeol(uInput);
@@ -491,11 +1655,11 @@ int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * user
 	/* header */
 	string userStatsMessage = "Total: ";
 	wattron(userStats, COLOR_PAIR(2));
-	mvwprintw(userStats, userStatsHeight/2, userStatsWidth/2-1, "%d", corUTrans);
+	mvwprintw(userStats, userStatsHeight/2, userStatsWidth/2-1, "%d", session.corUTrans);
 	wattroff(userStats, COLOR_PAIR(2));
 	wprintw(userStats, "/");
 	wprintw(userStats, "%d",curVoc);
-	mvwprintw(userStats, userStatsHeight-1, 1, "%s%d",userStatsMessage.c_str(),Vocs.vocNum);
+	mvwprintw(userStats, userStatsHeight-1, 1, "%s%d",userStatsMessage.c_str(),session.vocNum);
 	wrefresh(userStats);
 	/* fill stats window */
 		
@@ -508,21 +1672,20 @@ int queryEnToJa(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * user
  * @param queries Window containing the english or japanese vocabulary that is to be translated by the user
  * @param reply Window containing information whether the user translation is correct or not 
  * @param uInput Window where the user enters his translation
- * @param Vocs Structure containing all vocabulary and their amount
- * @param idx Index of the vocabulary to be queried
+ * @param session Session the vocabulary belongs to
+ * @param card The vocabulary to be queried, its direction was chosen at random
  * @param curVoc number of current vocabulary (to show how many words were queried so far)
  * @return Number which is -1 if ctrl(o) is pressed (go back to main menu) and 0 else
  */
-int queryMixed(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userStats, VocInfo Vocs, int idx, int curVoc) {
+int queryMixed(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userStats, Session & session, const Card & card, int curVoc) {
 	curs_set(true); cbreak(); echo(); nonl(); intrflush(stdscr, false); keypad(stdscr, true);
 	refresh();
 
-	/* randomly choose to query either ja->en or en->ja */
-	int rndm = rand() % 2;
+	/* query either ja->en or en->ja as randomly chosen by the session */
 	int status;
-	if (rndm == 0) status = queryJaToEn(queries, reply, uInput, userStats, Vocs, idx, curVoc);
-	else status = queryEnToJa(queries, reply, uInput, userStats, Vocs, idx, curVoc);
-	/* randomly choose to query either ja->en or en->ja */
+	if (card.jaToEn) status = queryJaToEn(queries, reply, uInput, userStats, session, card, curVoc);
+	else status = queryEnToJa(queries, reply, uInput, userStats, session, card, curVoc);
+	/* query either ja->en or en->ja as randomly chosen by the session */
 
 	wclear(queries);
 	wmove(uInput, 0, 0); wclrtoeol(uInput);
@@ -538,145 +1701,250 @@ int queryMixed(WINDOW * queries, WINDOW * reply, WINDOW * uInput, WINDOW * userS
  */
 void queryAll(string dict,int uOption) {
 	cbreak(); echo(); nonl(); intrflush(stdscr, false); keypad(stdscr, true);
-	clear();
 
 	/* colors */
 	init_pair(3, COLOR_YELLOW, COLOR_BLACK);
 	init_pair(4, COLOR_BLUE, COLOR_BLACK);
-	/* colors */
-
-	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
-
-	/* frame with option name */
-	attron(COLOR_PAIR(3));
-	box(stdscr, 0, 0);
-	attroff(COLOR_PAIR(3));
-	/* frame with option name */
-
-	/* queries window */
-	int queriesHeight, queriesWidth, queriesPosY, queriesPosX;
-	queriesHeight = 3;
-	queriesWidth = 60;
-	queriesPosY = maxY/4-queriesHeight/2;
-	queriesPosX = maxX/2-queriesWidth/2;
-	WINDOW * queries = newwin(queriesHeight, queriesWidth, queriesPosY, queriesPosX);
-	refresh();
-	/* queries window */
-
-	/* reply window */
-	int replyHeight, replyWidth, replyY, replyX;
-	replyHeight = 5;
-	replyWidth = 60;
-	replyY = 2*maxY/4-replyHeight/2;
-	replyX = maxX/2-replyWidth/2;
-	WINDOW * reply = newwin(replyHeight, replyWidth, replyY, replyX);
-	refresh();
-	/* reply window */
-
-	/* user statistics window */
-	int userStatsHeight, userStatsWidth, userStatsY, userStatsX;
-	userStatsY = maxY/16;
-	userStatsX = 6*maxX/7;
-	userStatsHeight = 7;
-	userStatsWidth = 20;
-	WINDOW * userStats = newwin(userStatsHeight, userStatsWidth, userStatsY, userStatsX);
-	refresh();
-	/* user statistics window */
-
-	/* user results window */
-	int resultsHeight, resultsWidth, resultsY, resultsX;
-	userStatsY = maxY/2-resultsHeight/2;
-	userStatsX = maxX/2-resultsWidth/2;
-	userStatsHeight = 12;
-	userStatsWidth = 25;
-	WINDOW * results = newwin(resultsHeight, resultsWidth, resultsY, resultsX);
-	refresh();
-	box(results, 0, 0);
-	wrefresh(results);
-	/* user results window */
+	/* colors */
 
-	/* user input */
-	int uInputHeight = 2; int uInputWidth = 30;
-	int uInputPosY = 3*maxY/4-uInputHeight/2; int uInputPosX = (maxX-uInputWidth)/2;
-	WINDOW * uInput = newwin(uInputHeight, uInputWidth, uInputPosY, uInputPosX);
-	refresh();
+	/* windows of the session */
+	layoutWindows();
+	WINDOW * queries = layout.queries;
+	WINDOW * reply = layout.reply;
+	WINDOW * userStats = layout.userStats;
+	WINDOW * results = layout.results;
+	WINDOW * uInput = layout.uInput;
+	const string * optNames[] = {&opt1, &opt2, &opt3};
+	sessionTitle = *optNames[uOption];
+	drawSessionFrame();
+	for (WINDOW * win : {queries, reply, userStats, layout.points, uInput, layout.examples}) {
+		if ( (win == layout.examples) && (!examplesShown()) ) continue;
+		werase(win); // clear what is left from the previous session
+		wnoutrefresh(win);
+	}
+	doupdate();
 	mkInputBox(uInput);
-	/* user input */
+	/* windows of the session */
 
-	VocInfo Vocs = getVocs(dict);
 	/* to query in a random order */
-	srand(time(NULL)); // init random seed based on sys time
-	vector<int> indexes;
-	for (int t=0; t<Vocs.vocNum;++t) indexes.push_back(t);	
-	std::random_shuffle(indexes.begin(),indexes.end());
+	Session session;
+	session.daemonFd = daemonFd;
+	if (daemonFd != -1) session.start(dict.substr(dict.find_last_of('/')+1), uOption, sessionSeed);
+	else session.start(std::make_shared<const VocInfo>(getVocs(dict)), uOption, sessionSeed);
+	Card card;
 	/* to query in a random order */
 	int status = 0;
+	if (drillSeconds) startCountdown(drillClock, drillSeconds);
 	
 	if (uOption == 0) {
-		wattron(stdscr, COLOR_PAIR(3));
-		mvwprintw(stdscr,0, 2, opt1.c_str());
-		wattroff(stdscr, COLOR_PAIR(3));
-		for (int i=0; i<Vocs.vocNum; ++i) {
-			status = queryJaToEn(queries, reply, uInput, userStats, Vocs, indexes[i],i);
-			if (status == -1) break;
+		for (int i=0; session.next(card); ++i) {
+			if (answerSeconds) startCountdown(answerClock, answerSeconds);
+			status = queryJaToEn(queries, reply, uInput, userStats, session, card, i);
+			stopCountdown(answerClock);
+			if (status != 0) break;
 		} 
 	}
 	if (uOption == 1) {
-		wattron(stdscr, COLOR_PAIR(3));
-		mvwprintw(stdscr,0, 2, opt2.c_str());
-		wattroff(stdscr, COLOR_PAIR(3));
-		for (int i=0; i<Vocs.vocNum; ++i) {
-			status = queryEnToJa(queries, reply, uInput, userStats, Vocs, indexes[i],i);
-			if (status == -1) break;
+		for (int i=0; session.next(card); ++i) {
+			if (answerSeconds) startCountdown(answerClock, answerSeconds);
+			status = queryEnToJa(queries, reply, uInput, userStats, session, card, i);
+			stopCountdown(answerClock);
+			if (status != 0) break;
 		}
 	}
 	if (uOption == 2) {
-		wattron(stdscr, COLOR_PAIR(3));
-		mvwprintw(stdscr,0, 2, opt3.c_str());
-		wattroff(stdscr, COLOR_PAIR(3));
-		for (int i=0; i<Vocs.vocNum; ++i) {
-			status = queryMixed(queries, reply, uInput, userStats, Vocs, indexes[i],i);
-			if (status == -1) break;
+		for (int i=0; session.next(card); ++i) {
+			if (answerSeconds) startCountdown(answerClock, answerSeconds);
+			status = queryMixed(queries, reply, uInput, userStats, session, card, i);
+			stopCountdown(answerClock);
+			if (status != 0) break;
 		}
 	}
 
-	if (status != -1) getch();
-	corUTrans = 0;
+	stopCountdown(drillClock);
+	events.posted.clear();
+
+	/* user results window */
+	if (status != -1) {
+		auto drawResults = [&]() {
+			int resultsHeight, resultsWidth; getmaxyx(results, resultsHeight, resultsWidth);
+			string correct = std::to_string(session.corUTrans)+"/"+std::to_string(session.answered);
+			werase(results);
+			wattron(results, COLOR_PAIR(3));
+			box(results, 0, 0);
+			mvwprintw(results, 0, 2, "Results");
+			wattroff(results, COLOR_PAIR(3));
+			mvwprintw(results, resultsHeight/2-1, 2, "correct:");
+			wattron(results, COLOR_PAIR(2));
+			mvwprintw(results, resultsHeight/2-1, resultsWidth-2-correct.length(), correct.c_str());
+			wattroff(results, COLOR_PAIR(2));
+			string confused = std::to_string(session.confusions.size());
+			mvwprintw(results, resultsHeight/2-3, 2, "mixed up:");
+			mvwprintw(results, resultsHeight/2-3, resultsWidth-2-confused.length(), confused.c_str());
+			mvwprintw(results, resultsHeight/2+1, 2, "total:");
+			mvwprintw(results, resultsHeight/2+1, resultsWidth-2-std::to_string(session.vocNum).length(), "%d", session.vocNum);
+			if (daemonFd != -1) {
+				vector<string> stats = session.request("STATS"); // all sessions of this user
+				stats.resize(5);
+				string allCorrect = stats[3]+"/"+stats[2];
+				mvwprintw(results, resultsHeight/2+3, 2, "all sessions:");
+				mvwprintw(results, resultsHeight/2+3, resultsWidth-2-allCorrect.length(), allCorrect.c_str());
+			}
+			wrefresh(results);
+		};
+		curs_set(false);
+		drawResults();
+		while (events.getKey(results) == KEY_RESIZE) {
+			redrawSession();
+			drawResults();
+		}
+		werase(results);
+	}
+	/* user results window */
+	Rng seeds;
+	seeds.seed(sessionSeed);
+	sessionSeed = seeds.next(); // a following session gets its own reproducible seed
 }
 
+/**
+ * Scrollable list that only draws the entries inside its window.
+ * Typing '/' starts a case insensitive filter which narrows the list with every
+ * typed character. The first character is answered from an index of all entries
+ * containing it, every further one only searches the entries that still match,
+ * and removing a character returns to the previous matches.
+ */
+struct ListView {
+	vector<string> items;
+	vector<string> lowered; // items in lower case
+	vector<vector<int>> byChar; // byte -> all items containing it
+	vector<vector<int>> matches; // matches[k] are the items fitting the first k filter characters
+	string filter;
+	bool filtering = false;
+	int selected = 0; // position inside matches.back()
+	int top = 0; // position of the first visible entry
+	int rowStep; // rows from one entry to the next
+
+	ListView(vector<string> choices, int rowStep) : items(std::move(choices)), byChar(256), rowStep(rowStep) {
+		matches.emplace_back();
+		for (int i=0; i<items.size(); ++i) {
+			string low = items[i];
+			std::transform(low.begin(), low.end(), low.begin(), ::tolower);
+			bool seen[256] = {};
+			for (unsigned char c : low) {
+				if (!seen[c]) byChar[c].push_back(i);
+				seen[c] = true;
+			}
+			lowered.push_back(std::move(low));
+			matches[0].push_back(i);
+		}
+	}
+
+	const vector<int> & shown() const { return matches.back(); }
+
+	void push(char c) {
+		filter += ::tolower(c);
+		if (filter.size() == 1) matches.push_back(byChar[(unsigned char) filter[0]]);
+		else {
+			vector<int> narrowed;
+			for (int i : shown()) if (lowered[i].find(filter) != string::npos) narrowed.push_back(i);
+			matches.push_back(std::move(narrowed));
+		}
+		selected = top = 0;
+	}
+
+	void pop() {
+		if (filter.empty()) return;
+		filter.pop_back();
+		matches.pop_back();
+		selected = top = 0;
+	}
+
+	void clearFilter() {
+		filter.clear();
+		matches.resize(1);
+		filtering = false;
+		selected = top = 0;
+	}
+
+	/* moves the selection by delta entries, wrapping around at both ends */
+	void move(int delta) {
+		int count = shown().size();
+		if (count == 0) return;
+		selected = ((selected+delta) % count + count) % count;
+	}
+
+	/* draws the visible entries and the filter into the frame of win */
+	void draw(WINDOW * win) {
+		int height, width; getmaxyx(win, height, width);
+		int firstRow = std::max(1, height/5);
+		int visible = std::max(1, (height-2-firstRow)/rowStep+1);
+		if (selected < top) top = selected;
+		if (selected >= top+visible) top = selected-visible+1;
+
+		for (int row=firstRow; row<height-1; ++row) mvwhline(win, row, 1, ' ', width-2);
+		for (int k=0; (k<visible) && (top+k<shown().size()); ++k) {
+			int row = firstRow+k*rowStep;
+			if (top+k == selected) wattron(win, COLOR_PAIR(1));
+			mvwaddnstr(win, row, 1, items[shown()[top+k]].c_str(), width-2);
+			wattroff(win, COLOR_PAIR(1));
+		}
+		if (top > 0) mvwaddch(win, firstRow, width-2, ACS_UARROW);
+		if (top+visible < shown().size()) mvwaddch(win, firstRow+(visible-1)*rowStep, width-2, ACS_DARROW);
+		if (filtering) {
+			string prompt = "/"+filter;
+			if (prompt.length() > width-4) prompt = prompt.substr(prompt.length()-(width-4));
+			mvwprintw(win, height-1, 2, "%s", prompt.c_str());
+		}
+		wrefresh(win);
+	}
+};
+
 /**
  * Creates a menu where the user selects a query type (english to japanese, japanese to english, mixed)
  *
  * @param opts Window holding all options
  * @param choices The options which the user can select
+ * @param drawFrame Draws the menu frame again, after the terminal was resized or the filter changed
+ * @return Index of the selected option inside choices
  */
-int selectionMenu(WINDOW * opts, vector<string> choices) {
+int selectionMenu(WINDOW * opts, vector<string> choices, std::function<void()> drawFrame) {
 	keypad(opts, true);
 	/* colors */
 	init_pair(1, COLOR_RED, COLOR_BLACK);
 	/* colors */
 
-	int selected = 0;
+	ListView list(std::move(choices), 2);
 	while (true) {
-		for (int i=0;i<choices.size();++i) {
-			if (selected == i) wattron(opts, COLOR_PAIR(1));
-			mvwprintw(opts, (opts->_maxy+1)/5+2*i, 1, choices[i].c_str());
-			wattroff(opts, COLOR_PAIR(1));
-		}	
-		int uDir = wgetch(opts);
-
-		if ( (uDir==(int) 'k') || (uDir==KEY_UP) ) {
-			--selected;
-			if (selected == -1) selected = choices.size()-1;
+		list.draw(opts);
+		int uDir = events.getKey(opts);
+
+		if (uDir == KEY_UP) list.move(-1);
+		else if (uDir == KEY_DOWN) list.move(1);
+		else if (uDir == KEY_PPAGE) list.move(-std::max(1, getmaxy(opts)/list.rowStep-1));
+		else if (uDir == KEY_NPAGE) list.move(std::max(1, getmaxy(opts)/list.rowStep-1));
+		else if (uDir == KEY_RESIZE) {
+			layoutWindows();
+			erase();
+			wnoutrefresh(stdscr);
+			drawFrame();
 		}
-		else if ( (uDir==(int) 'j') || (uDir==KEY_DOWN) ) {
-			++selected;
-			if (selected == choices.size()) selected = 0;
+		else if ( (uDir == 13) && (!list.shown().empty()) ) return list.shown()[list.selected];
+		else if (uDir == 27) { // escape
+			list.clearFilter();
+			drawFrame();
+		}
+		else if (list.filtering) {
+			if ( (uDir == KEY_BACKSPACE) || (uDir == 127) || (uDir == 8) ) list.pop();
+			else if ( (uDir >= ' ') && (uDir < 256) ) list.push(uDir);
+			drawFrame();
+		}
+		else if (uDir == (int) 'k') list.move(-1);
+		else if (uDir == (int) 'j') list.move(1);
+		else if (uDir == (int) '/') {
+			list.filtering = true;
+			drawFrame();
 		}
-
-		if (uDir == 13) break;
 	}
-	return selected;
 }
 
 /**
@@ -685,12 +1953,9 @@ int selectionMenu(WINDOW * opts, vector<string> choices) {
  * @return Name of the selected dictionary file
  */
 string dictSelect(string projectDir) {
-	int y,x;
-	int dictSelectH, dictSelectW;
 	int choice;
 	vector<string> dicts;
 	string dictsDir = "/dicts";
-	getmaxyx(stdscr, y, x);
 	projectDir += dictsDir;
 	/* get all file names in dictionary subfolder */
 	for (const auto & entry : std::filesystem::directory_iterator(projectDir)){
@@ -698,17 +1963,24 @@ string dictSelect(string projectDir) {
 		dictFileName.erase(0,dictFileName.find_last_of('/')+1);
 		dicts.push_back(dictFileName);
 	}
+	std::sort(dicts.begin(), dicts.end());
 	/* get all file names in dictionary subfolder */
 	/* dictionary select window */
-	dictSelectW = 20;
-	dictSelectH = 2*dicts.size()+3;
-	WINDOW * dictsSelect = newwin(dictSelectH, dictSelectW, y/2-dictSelectH, 2*x/3);
-	refresh();
-	box(dictsSelect, 0, 0);
-	wrefresh(dictsSelect);
-	mvwprintw(dictsSelect, 0, 2, "Dictionaries");
+	layout.dictsHeight = 2*dicts.size()+3;
+	layoutWindows();
+	WINDOW * dictsSelect = layout.dictsSelect;
+	auto drawFrame = [&]() {
+		touchwin(layout.opts); // the options menu stays visible behind
+		wnoutrefresh(layout.opts);
+		werase(dictsSelect);
+		box(dictsSelect, 0, 0);
+		mvwprintw(dictsSelect, 0, 2, "Dictionaries");
+		wnoutrefresh(dictsSelect);
+		doupdate();
+	};
+	drawFrame();
 	/* dictionary select window */
-	choice = selectionMenu(dictsSelect, dicts);
+	choice = selectionMenu(dictsSelect, dicts, drawFrame);
 	werase(dictsSelect);
 	return dicts[choice];
 }
@@ -725,31 +1997,34 @@ string dictSelect(string projectDir) {
 int mkOptsWin(string query1, string query2, string query3, string exit, string dicts){
 	curs_set(false); cbreak(); noecho(); nonl(); intrflush(stdscr, false); keypad(stdscr, true);
 	clear();
+	refresh();
 
 	/* colors */
 	init_pair(3, COLOR_YELLOW, COLOR_BLACK);
 	/* colors */
 
-	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
-	int optsWidth = query3.length()+7;
-	int optsHeight = 13;
-	WINDOW* opts = newwin(optsHeight, optsWidth, maxY/2-optsHeight, maxX/2-optsWidth/2);
-	refresh();
+	layout.optsWidth = query3.length()+7;
+	layoutWindows();
+	WINDOW* opts = layout.opts;
 
 	/* box with name */
-	wattron(opts, COLOR_PAIR(3));
-	box(opts, 0, 0);
-	string tag = "Options";
-	mvwprintw(opts, 0, optsWidth/2-tag.length()/2-1, tag.c_str());
-	wattroff(opts, COLOR_PAIR(3));
+	auto drawFrame = [&]() {
+		werase(opts);
+		wattron(opts, COLOR_PAIR(3));
+		box(opts, 0, 0);
+		string tag = "Options";
+		mvwprintw(opts, 0, getmaxx(opts)/2-tag.length()/2-1, tag.c_str());
+		wattroff(opts, COLOR_PAIR(3));
+		wrefresh(opts);
+	};
+	drawFrame();
 	/* box with name */
-	wrefresh(opts);
 
 	//string choices[] = {query1,query2,query3,opt4};
 	vector<string> choices;	
 	choices.push_back(query1); choices.push_back(query2); choices.push_back(query3); choices.push_back(exit);
 	choices.push_back(dicts);
-	return selectionMenu(opts, choices);
+	return selectionMenu(opts, choices, drawFrame);
 }
 
 /**
@@ -769,49 +2044,956 @@ void mkStartWin(string name, string subtitle) {
 	noecho(); curs_set(false);
 	int horPadding = 8;
 	int titleHeight = 5; int titleWidth = name.length()+horPadding;
-	int maxY, maxX; getmaxyx(stdscr, maxY, maxX);
-	int titlePosY = 2*maxY/5-titleHeight/2; int titlePosX = maxX/2-titleWidth/2;
+	int maxY, maxX;
+	int titlePosY, titlePosX;
 	int curPosY = 0;
+	layout.titleWidth = titleWidth;
+	layoutWindows();
+	WINDOW * title = layout.title;
+	getbegyx(title, titlePosY, titlePosX); // where the title comes to rest
+	getmaxyx(stdscr, maxY, maxX);
+
+	auto drawTitle = [&]() {
+		erase();
+		wnoutrefresh(stdscr);
+		mvwin(title, curPosY, titlePosX);
+		werase(title);
 
-	while (curPosY <= titlePosY) {
-		clear();
-		WINDOW * title = newwin(titleHeight, titleWidth, curPosY, titlePosX);
-		++curPosY;
-		refresh();
-		
 		/* box */
 		wattron(title, COLOR_PAIR(3));
 		box(title, 0,0);
 		wattroff(title, COLOR_PAIR(3));
-		wrefresh(title);
 		/* box */
 
 		/* box text */
 		wattron(title,COLOR_PAIR(1)); wattron(title, A_BOLD);
 		mvwprintw(title, titleHeight/2, horPadding/2, name.c_str());
 		wattroff(title, A_BOLD); wattroff(title,COLOR_PAIR(1));
-		wrefresh(title);
 		/* box text */
 
-		usleep(2E4);
-	}
+		wnoutrefresh(title);
+		doupdate();
+	};
 	/* header */
 
 	/* sub header */
-	int lenEnter = subtitle.length();
-	attron(A_BLINK);
-	mvprintw(titlePosY+titleHeight, maxX/2-(lenEnter+8)/2, subtitle.c_str());
+	auto drawSubtitle = [&]() {
+		int lenEnter = subtitle.length();
+		attron(A_BLINK);
+		mvprintw(titlePosY+titleHeight, maxX/2-(lenEnter+8)/2, subtitle.c_str());
+
+		printw(" ("); 
+		attron(COLOR_PAIR(3));
+		printw("Enter");
+		attroff(COLOR_PAIR(3));
+		printw(")");
+		attroff(A_BLINK);
+		refresh();
+	};
+	/* sub header */
 
-	printw(" ("); 
-	attron(COLOR_PAIR(3));
-	printw("Enter");
-	attroff(COLOR_PAIR(3));
-	printw(")");
-	attroff(A_BLINK);
+	/* the title slides down one line per frame while Enter may already be pressed */
+	drawTitle();
+	int frame = events.addTimer(20, true, [&]() {
+		if (curPosY >= titlePosY) {
+			events.cancelTimer(frame);
+			drawSubtitle();
+			return;
+		}
+		++curPosY;
+		drawTitle();
+	});
+	int uChar;
+	while ( (uChar = events.getKey(stdscr)) != 13 ) {
+		if (uChar != KEY_RESIZE) continue;
+		layoutWindows();
+		getbegyx(title, titlePosY, titlePosX);
+		getmaxyx(stdscr, maxY, maxX);
+		curPosY = std::min(curPosY, titlePosY);
+		drawTitle();
+		if (frame == -1) drawSubtitle();
+	}
+	events.cancelTimer(frame);
+}
 
-	int uChar = getch();
-	while (uChar != 13) uChar = getch();
-	/* sub header */
+/**
+ * Escapes a string for use inside a JSON string literal
+ *
+ * @param text Unescaped text
+ * @return Escaped text without surrounding quotes
+ */
+string jsonEscape(const string & text) {
+	string escaped;
+	for (unsigned char c : text) {
+		if (c == '"') escaped += "\\\"";
+		else if (c == '\\') escaped += "\\\\";
+		else if (c == '\n') escaped += "\\n";
+		else if (c == '\t') escaped += "\\t";
+		else if (c < 0x20) {
+			char code[7];
+			snprintf(code, sizeof(code), "\\u%04x", c);
+			escaped += code;
+		}
+		else escaped += c;
+	}
+	return escaped;
+}
+
+/**
+ * Rows of an answers file that are graded together by one pool task
+ */
+struct GradeBatch {
+	vector<string> rows;
+	string out; // formatted results of all rows
+	int correct = 0;
+	bool done = false;
+};
+
+/**
+ * Grades every (entry, direction, answer) row of a tab separated answers file.
+ * An entry is either the index of a vocabulary or its queried word, the direction is
+ * "ja-en" or "en-ja". Rows are read in batches and graded on a thread pool while only
+ * a fixed number of batches is held in memory, results keep the order of the input.
+ *
+ * @param answersFile Name of the answers file
+ * @param dict Name of the dictionary file the answers refer to
+ * @param outFile Name of the results file, standard output if empty
+ * @param asJson Write the results as a JSON array instead of tab separated values
+ * @param threads Number of worker threads
+ */
+void gradeAnswers(string answersFile, string dict, string outFile, bool asJson, unsigned threads) {
+	const VocInfo Vocs = getVocs(dict);
+	std::unordered_map<string,int> jaIdx, enIdx; // queried word -> vocabulary index
+	for (int i=Vocs.vocNum-1; i>=0; --i) {
+		jaIdx[Vocs.ja[i]] = i;
+		enIdx[Vocs.en[i]] = i;
+	}
+
+	fstream answers (answersFile, ios::in);
+	if (!answers) throw "File \""+answersFile+"\" not found.";
+	std::ofstream results;
+	if (!outFile.empty()) {
+		results.open(outFile);
+		if (!results) throw "File \""+outFile+"\" could not be written.";
+	}
+	std::ostream & out = (outFile.empty()) ? std::cout : results;
+
+	/* grades one row and appends its formatted result, true if the answer is correct */
+	auto gradeRow = [&](const string & row, string & text) {
+		string fields[3];
+		size_t start = 0;
+		for (int f=0; f<3; ++f) {
+			size_t end = (f<2) ? row.find('\t', start) : string::npos;
+			fields[f] = row.substr(start, (end==string::npos) ? string::npos : end-start);
+			if (end == string::npos) break;
+			start = end+1;
+		}
+		const string & entry = fields[0];
+		const string & direction = fields[1];
+		const string & answer = fields[2];
+
+		string result = "invalid";
+		string expected;
+		string confusedWith; // queried word of the vocabulary a wrong answer belongs to
+		bool jaToEn = (direction == "ja-en");
+		if ( jaToEn || (direction == "en-ja") ) {
+			int idx = -1;
+			if ( (!entry.empty()) && (entry.size() < 10) && (entry.find_first_not_of("0123456789") == string::npos) ) {
+				idx = std::stoi(entry);
+				if (idx >= Vocs.vocNum) idx = -1;
+			}
+			else {
+				const std::unordered_map<string,int> & index = (jaToEn) ? jaIdx : enIdx;
+				auto it = index.find(entry);
+				if (it != index.end()) idx = it->second;
+			}
+			if (idx != -1) {
+				Grade grade = gradeAnswer(Vocs, idx, jaToEn, answer);
+				result = (grade.correct) ? "correct" : "wrong";
+				if (jaToEn) {
+					for (int i=0;i<grade.remTrans.size();++i) (i==0) ? expected += grade.remTrans[i] : expected += ";"+grade.remTrans[i];
+				}
+				else (Vocs.furi[idx].empty()) ? (expected = Vocs.ja[idx]) : (expected = Vocs.ja[idx]+" ["+Vocs.furi[idx]+"]");
+				confusedWith = grade.confusedWith;
+			}
+		}
+
+		if (asJson) {
+			text += "{\"entry\":\""+jsonEscape(entry)+"\",\"direction\":\""+jsonEscape(direction)+"\",\"answer\":\""+jsonEscape(answer)
+				+"\",\"result\":\""+result+"\",\"expected\":\""+jsonEscape(expected)+"\",\"confused_with\":\""+jsonEscape(confusedWith)+"\"}";
+		}
+		else text += entry+"\t"+direction+"\t"+answer+"\t"+result+"\t"+expected+"\t"+confusedWith;
+		return result == "correct";
+	};
+
+	const int batchSize = 4096;
+	const int maxBatches = 4*threads; // bounds the rows held in memory
+	std::mutex doneLock;
+	std::condition_variable batchDone;
+	std::deque<std::shared_ptr<GradeBatch>> inFlight;
+	long gradedRows = 0, correctRows = 0;
+	bool firstBatch = true;
+
+	/* waits until the oldest batch is graded and writes it */
+	auto writeOldest = [&]() {
+		std::shared_ptr<GradeBatch> batch = inFlight.front();
+		{
+			std::unique_lock<std::mutex> waiting(doneLock);
+			batchDone.wait(waiting, [&]{ return batch->done; });
+		}
+		if (asJson) out << ((firstBatch) ? "\n  " : ",\n  ");
+		out << batch->out;
+		if (!asJson) out << '\n';
+		firstBatch = false;
+		gradedRows += batch->rows.size();
+		correctRows += batch->correct;
+		inFlight.pop_front();
+	};
+
+	out << ((asJson) ? "[" : "entry\tdirection\tanswer\tresult\texpected\tconfused_with\n");
+	{
+		ThreadPool pool(threads);
+		string line;
+		while (true) {
+			auto batch = std::make_shared<GradeBatch>();
+			while ( (batch->rows.size() < batchSize) && getline(answers, line) ) {
+				if ( (!line.empty()) && (line.back() == '\r') ) line.pop_back();
+				if (!line.empty()) batch->rows.push_back(line);
+			}
+			if (batch->rows.empty()) break;
+			if (inFlight.size() == maxBatches) writeOldest();
+			inFlight.push_back(batch);
+			pool.submit([batch, &gradeRow, &doneLock, &batchDone, asJson]() {
+				for (int i=0; i<batch->rows.size(); ++i) {
+					if (i > 0) batch->out += (asJson) ? ",\n  " : "\n";
+					if (gradeRow(batch->rows[i], batch->out)) ++batch->correct;
+				}
+				{
+					std::lock_guard<std::mutex> guard(doneLock);
+					batch->done = true;
+				}
+				batchDone.notify_all();
+			});
+		}
+		while (!inFlight.empty()) writeOldest();
+	}
+	if (asJson) out << ((firstBatch) ? "]\n" : "\n]\n");
+	out.flush();
+	answers.close();
+
+	cerr << correctRows << "/" << gradedRows << " answers correct" << endl;
+}
+
+/**
+ * Creates the inverted index of an example sentence corpus. It is written next to
+ * the corpus, with ".idx" appended to the corpus file name.
+ *
+ * @param corpusFile Name of the corpus file, one tab separated sentence pair per line
+ */
+void buildExampleIndex(string corpusFile) {
+	fstream corpusIn (corpusFile, ios::in | ios::binary);
+	if (!corpusIn) throw "File \""+corpusFile+"\" not found.";
+
+	/* collect the sentences containing each token */
+	vector<ExampleSentence> sentences;
+	std::unordered_map<uint64_t, vector<uint32_t>> tokenSentences;
+	string line;
+	uint64_t offset = 0;
+	Example example;
+	vector<string> words;
+	while (getline(corpusIn, line)) {
+		uint64_t lineOffset = offset;
+		offset += line.size()+1;
+		if (!splitExample(line.data(), line.size(), example)) continue;
+		uint32_t id = sentences.size();
+		sentences.push_back({lineOffset, (uint32_t) line.size(), 0});
+		vector<uint64_t> tokens = jaTokens(example.ja);
+		vector<uint64_t> enToks = enTokens(example.en, words);
+		tokens.insert(tokens.end(), enToks.begin(), enToks.end());
+		std::sort(tokens.begin(), tokens.end());
+		tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+		for (uint64_t token : tokens) tokenSentences[token].push_back(id);
+	}
+	corpusIn.close();
+	/* collect the sentences containing each token */
+
+	/* hash table with linear probing, at most half full */
+	uint32_t bucketNum = 1;
+	while (bucketNum < 2*tokenSentences.size()) bucketNum *= 2;
+	vector<ExampleBucket> buckets(bucketNum, ExampleBucket{0, 0, 0});
+	uint64_t postingNum = 0;
+	for (const auto & token : tokenSentences) {
+		uint32_t b = token.first & (bucketNum-1);
+		while (buckets[b].hash != 0) b = (b+1) & (bucketNum-1);
+		buckets[b] = {token.first, (uint32_t) postingNum, (uint32_t) token.second.size()};
+		postingNum += token.second.size();
+		if (postingNum > UINT32_MAX) throw string("Corpus \""+corpusFile+"\" is too large to index.");
+	}
+	/* hash table with linear probing, at most half full */
+
+	ExampleHeader header;
+	memcpy(header.magic, exampleMagic, 8);
+	header.corpusSize = std::filesystem::file_size(corpusFile);
+	header.sentences = sentences.size();
+	header.buckets = bucketNum;
+	header.postings = postingNum;
+
+	string indexFile = corpusFile+".idx";
+	std::ofstream out (indexFile+".tmp", ios::binary);
+	if (!out) throw "File \""+indexFile+"\" could not be written.";
+	out.write((const char *) &header, sizeof(header));
+	out.write((const char *) sentences.data(), sentences.size()*sizeof(ExampleSentence));
+	out.write((const char *) buckets.data(), buckets.size()*sizeof(ExampleBucket));
+	for (const auto & token : tokenSentences) out.write((const char *) token.second.data(), token.second.size()*sizeof(uint32_t)); // same order as above
+	out.close();
+	if (!out) throw "File \""+indexFile+"\" could not be written.";
+	std::filesystem::rename(indexFile+".tmp", indexFile);
+
+	cerr << "Indexed " << sentences.size() << " sentences with " << tokenSentences.size() << " tokens into " << indexFile << endl;
+}
+
+/**
+ * Streaming XML reader reporting one tag or text at a time, so documents of any
+ * size are read with memory bounded by their largest element. It supports what
+ * dictionary exports need: the document type declaration with its internal
+ * subset, comments and processing instructions are skipped.
+ */
+struct XmlReader {
+	enum Event { startTag, endTag, text, end };
+
+	std::streambuf * in;
+	string name; // name of the current tag
+	string attributes; // unparsed attributes of the current start tag
+	string content; // decoded text
+	bool closePending = false; // the last start tag closed itself
+
+	explicit XmlReader(std::istream & stream) : in(stream.rdbuf()) {}
+
+	/**
+	 * Reads the next tag or text
+	 *
+	 * @return Kind of what was read, details are in name, attributes and content
+	 */
+	Event next() {
+		if (closePending) {
+			closePending = false;
+			return endTag;
+		}
+		while (true) {
+			int c = in->sgetc();
+			if (c == EOF) return end;
+			if (c != '<') {
+				readText();
+				return text;
+			}
+			in->sbumpc();
+			c = in->sbumpc();
+			if (c == '/') {
+				readName();
+				skipPast('>');
+				return endTag;
+			}
+			if (c == '?') skipPast("?>");
+			else if (c == '!') {
+				if ( (in->sgetc() == '-') && (in->sbumpc() != EOF) && (in->sgetc() == '-') ) skipPast("-->");
+				else skipDeclaration();
+			}
+			else if (c != EOF) {
+				in->sungetc();
+				readName();
+				attributes.clear();
+				for (int a = in->sbumpc(), quote = 0; a != EOF; a = in->sbumpc()) {
+					if ( (a == '>') && (quote == 0) ) break;
+					if ( (a == '"') || (a == '\'') ) quote = (quote == 0) ? a : ((quote == a) ? 0 : quote);
+					attributes += (char) a;
+				}
+				if ( (!attributes.empty()) && (attributes.back() == '/') ) {
+					attributes.pop_back();
+					closePending = true;
+				}
+				return startTag;
+			}
+		}
+	}
+
+	/**
+	 * Gets an attribute of the current start tag
+	 *
+	 * @param key Name of the attribute
+	 * @return Its value, empty if the tag has none
+	 */
+	string attribute(const string & key) const {
+		size_t pos = 0;
+		while ( (pos = attributes.find(key, pos)) != string::npos ) {
+			size_t eq = attributes.find_first_not_of(" \t\r\n", pos+key.size());
+			bool whole = (pos == 0) || isspace((unsigned char) attributes[pos-1]);
+			if ( whole && (eq != string::npos) && (attributes[eq] == '=') ) {
+				size_t open = attributes.find_first_of("\"'", eq);
+				if (open == string::npos) return "";
+				size_t close = attributes.find(attributes[open], open+1);
+				return attributes.substr(open+1, close-open-1);
+			}
+			pos += key.size();
+		}
+		return "";
+	}
+
+private:
+	void readName() {
+		name.clear();
+		for (int c = in->sgetc(); (c != EOF) && (!isspace(c)) && (c != '>') && (c != '/'); c = in->snextc()) name += (char) c;
+	}
+
+	void readText() {
+		content.clear();
+		for (int c = in->sgetc(); (c != EOF) && (c != '<'); c = in->snextc()) {
+			if (c != '&') {
+				content += (char) c;
+				continue;
+			}
+			string entity;
+			for (c = in->snextc(); (c != EOF) && (c != ';') && (c != '<') && (entity.size() < 16); c = in->snextc()) entity += (char) c;
+			if (c != ';') {
+				content += "&"+entity;
+				in->sungetc();
+			}
+			else decodeEntity(entity);
+		}
+	}
+
+	/* appends the character an entity stands for, unknown entities are kept as they are */
+	void decodeEntity(const string & entity) {
+		if (entity == "amp") content += '&';
+		else if (entity == "lt") content += '<';
+		else if (entity == "gt") content += '>';
+		else if (entity == "quot") content += '"';
+		else if (entity == "apos") content += '\'';
+		else if ( (entity.size() > 1) && (entity[0] == '#') ) {
+			unsigned long code = (entity[1] == 'x') ? strtoul(entity.c_str()+2, nullptr, 16) : strtoul(entity.c_str()+1, nullptr, 10);
+			/* utf-8 encoding */
+			if (code < 0x80) content += (char) code;
+			else if (code < 0x800) {
+				content += (char) (0xc0 | (code >> 6));
+				content += (char) (0x80 | (code & 0x3f));
+			}
+			else if (code < 0x10000) {
+				content += (char) (0xe0 | (code >> 12));
+				content += (char) (0x80 | ((code >> 6) & 0x3f));
+				content += (char) (0x80 | (code & 0x3f));
+			}
+			else {
+				content += (char) (0xf0 | (code >> 18));
+				content += (char) (0x80 | ((code >> 12) & 0x3f));
+				content += (char) (0x80 | ((code >> 6) & 0x3f));
+				content += (char) (0x80 | (code & 0x3f));
+			}
+		}
+		else content += "&"+entity+";";
+	}
+
+	void skipPast(char last) {
+		for (int c = in->sbumpc(); (c != EOF) && (c != last); c = in->sbumpc());
+	}
+
+	void skipPast(const string & last) {
+		size_t matched = 0;
+		for (int c = in->sbumpc(); (c != EOF) && (matched < last.size()); c = in->sbumpc()) {
+			matched = (c == last[matched]) ? matched+1 : ((c == last[0]) ? 1 : 0);
+			if (matched == last.size()) return;
+		}
+	}
+
+	/* skips <!DOCTYPE ...> including an internal subset in brackets, whose comments may contain lone quotes */
+	void skipDeclaration() {
+		int depth = 0, quote = 0;
+		for (int c = in->sbumpc(); c != EOF; c = in->sbumpc()) {
+			if (quote != 0) {
+				if (c == quote) quote = 0;
+			}
+			else if ( (c == '<') && (in->sgetc() == '?') ) skipPast("?>");
+			else if ( (c == '<') && (in->sgetc() == '!') && (in->snextc() == '-') && (in->snextc() == '-') ) skipPast("-->");
+			else if ( (c == '"') || (c == '\'') ) quote = c;
+			else if (c == '[') ++depth;
+			else if (c == ']') --depth;
+			else if ( (c == '>') && (depth <= 0) ) return;
+		}
+	}
+};
+
+/**
+ * Writes a vocabulary in the notation of the dictionary files
+ *
+ * @param out The dictionary file
+ * @param first Whether this is the first vocabulary of the file, the others are preceded by a blank line
+ * @param glosses English translations
+ * @param kanji Kanji notation, empty if the word is written in kana only
+ * @param reading Kana notation
+ * @return False if the vocabulary lacks a translation or notation and was skipped
+ */
+bool writeVoc(std::ostream & out, bool first, const vector<string> & glosses, const string & kanji, const string & reading) {
+	string en, ja, furi;
+	vector<string> kept;
+	for (string gloss : glosses) {
+		std::replace(gloss.begin(), gloss.end(), ';', ','); // semicolons separate translations
+		gloss = trim(gloss);
+		if ( gloss.empty() || (std::find(kept.begin(), kept.end(), gloss) != kept.end()) ) continue; // senses may repeat glosses
+		kept.push_back(gloss);
+		(en.empty()) ? en = gloss : en += ";"+gloss;
+	}
+	ja = (kanji.empty()) ? reading : kanji;
+	if (ja != reading) furi = reading; // kana only words have no furigana
+	if ( en.empty() || ja.empty() ) return false;
+	for (string * field : {&en, &ja, &furi}) std::replace_if(field->begin(), field->end(), [](char c) { return (c == '\n') || (c == '\r'); }, ' ');
+	out << ((first) ? "" : "\n") << en << "\n" << ja << "\n" << furi << "\n";
+	return true;
+}
+
+/**
+ * Converts a JMdict XML file into the dictionary notation. Entries are read one at
+ * a time: the first kanji notation, the first reading and all english glosses are kept.
+ *
+ * @param in The JMdict file
+ * @param out The dictionary file
+ * @return Number of imported vocabularies
+ */
+long importJmdict(std::istream & in, std::ostream & out) {
+	XmlReader xml(in);
+	vector<string> glosses;
+	string kanji, reading;
+	bool english = false;
+	string field; // element whose text is read: keb, reb or gloss
+	long imported = 0;
+	for (XmlReader::Event event = xml.next(); event != XmlReader::end; event = xml.next()) {
+		if (event == XmlReader::startTag) {
+			if (xml.name == "entry") {
+				glosses.clear();
+				kanji.clear();
+				reading.clear();
+			}
+			else if (xml.name == "gloss") {
+				string lang = xml.attribute("xml:lang");
+				english = lang.empty() || (lang == "eng") || (lang == "en");
+			}
+			field = xml.name;
+		}
+		else if (event == XmlReader::text) {
+			if ( (field == "keb") && kanji.empty() ) kanji = xml.content;
+			else if ( (field == "reb") && reading.empty() ) reading = xml.content;
+			else if ( (field == "gloss") && english ) glosses.push_back(xml.content);
+		}
+		else {
+			field.clear();
+			if ( (xml.name == "entry") && writeVoc(out, imported == 0, glosses, kanji, reading) ) ++imported;
+		}
+	}
+	return imported;
+}
+
+/**
+ * Splits one row of a character separated file. Quoted fields may contain the
+ * separator, doubled quotes and line breaks.
+ *
+ * @param row The row, including the line breaks of quoted fields
+ * @param sep Separator of the fields
+ * @param quoted Whether fields may be quoted
+ * @return The fields
+ */
+vector<string> splitRow(const string & row, char sep, bool quoted) {
+	vector<string> fields(1);
+	bool inQuotes = false;
+	for (size_t i=0; i<row.size(); ++i) {
+		char c = row[i];
+		if (inQuotes) {
+			if ( (c == '"') && (i+1 < row.size()) && (row[i+1] == '"') ) fields.back() += row[i++];
+			else if (c == '"') inQuotes = false;
+			else fields.back() += c;
+		}
+		else if ( quoted && (c == '"') && fields.back().empty() ) inQuotes = true;
+		else if (c == sep) fields.emplace_back();
+		else if (c != '\r') fields.back() += c;
+	}
+	return fields;
+}
+
+/**
+ * Converts a tab or comma separated file into the dictionary notation
+ *
+ * @param in The file
+ * @param out The dictionary file
+ * @param sep Separator of the fields, quoting is supported for commas
+ * @param columns What each column contains: "kanji", "reading", "gloss" or "-" to skip it
+ * @return Number of imported vocabularies
+ */
+long importRows(std::istream & in, std::ostream & out, char sep, const vector<string> & columns) {
+	vector<string> glosses;
+	string kanji, reading, row;
+	long imported = 0;
+	bool firstRow = true;
+	while (getline(in, row)) {
+		if ( row.empty() || (row[0] == '#') ) continue; // comments such as the header of anki exports
+		/* a quoted line break continues the row on the next line */
+		string next;
+		while ( (sep == ',') && (std::count(row.begin(), row.end(), '"') % 2 == 1) && getline(in, next) ) row += "\n"+next;
+		vector<string> fields = splitRow(row, sep, sep == ',');
+		/* a first row naming the columns like --fields is a header */
+		bool header = firstRow;
+		for (size_t i=0; header && (i<columns.size()); ++i) {
+			string cell = (i<fields.size()) ? fields[i] : "";
+			std::transform(cell.begin(), cell.end(), cell.begin(), ::tolower);
+			header = (columns[i] == "-") || (cell == columns[i]);
+		}
+		firstRow = false;
+		if (header) continue;
+		glosses.clear();
+		kanji.clear();
+		reading.clear();
+		for (size_t i=0; (i<fields.size()) && (i<columns.size()); ++i) {
+			if (columns[i] == "kanji") kanji = fields[i];
+			else if (columns[i] == "reading") reading = fields[i];
+			else if (columns[i] == "gloss") glosses.push_back(fields[i]);
+		}
+		if (writeVoc(out, imported == 0, glosses, kanji, reading)) ++imported;
+	}
+	return imported;
+}
+
+/**
+ * Imports a JMdict, tab separated or comma separated file as a dictionary file.
+ * The input is streamed, so only a single entry is held in memory at a time.
+ *
+ * @param importFile Name of the file to import
+ * @param dictFile Name of the dictionary file to write
+ * @param format "jmdict", "tsv" or "csv", guessed from the file extension if empty
+ * @param fields Comma separated meaning of the columns of tsv and csv files
+ * @param overwrite Whether an existing dictionary file may be replaced
+ */
+void importDict(string importFile, string dictFile, string format, string fields, bool overwrite) {
+	if (format.empty()) {
+		string ext = importFile.substr(importFile.find_last_of('.')+1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+		if ( (ext == "xml") || (importFile.find("JMdict") != string::npos) ) format = "jmdict";
+		else format = (ext == "csv") ? "csv" : "tsv";
+	}
+	vector<string> columns;
+	for (size_t start = 0; start <= fields.size();) {
+		size_t end = fields.find(',', start);
+		if (end == string::npos) end = fields.size();
+		columns.push_back(trim(fields.substr(start, end-start)));
+		if ( (columns.back() != "kanji") && (columns.back() != "reading") && (columns.back() != "gloss") && (columns.back() != "-") ) {
+			throw "Unknown field \""+columns.back()+"\", fields are kanji, reading, gloss or -.";
+		}
+		start = end+1;
+	}
+
+	fstream in (importFile, ios::in | ios::binary);
+	if (!in) throw "File \""+importFile+"\" not found.";
+	if ( (!overwrite) && std::filesystem::exists(dictFile) ) throw "File \""+dictFile+"\" already exists, name it with --out to replace it.";
+
+	/* the dictionary file is only replaced by a complete import */
+	string partFile = dictFile+".part";
+	std::ofstream out (partFile);
+	if (!out) throw "File \""+dictFile+"\" could not be written.";
+	long imported = (format == "jmdict") ? importJmdict(in, out) : importRows(in, out, (format == "csv") ? ',' : '\t', columns);
+	out.close();
+	if ( (!out) || (imported == 0) ) {
+		std::filesystem::remove(partFile);
+		if (!out) throw "File \""+dictFile+"\" could not be written.";
+		throw "No vocabularies found in \""+importFile+"\", check --format and --fields.";
+	}
+	std::filesystem::rename(partFile, dictFile);
+	cerr << "Imported " << imported << " vocabularies into " << dictFile << endl;
+}
+
+/**
+ * Folder of the socket of cursaryd
+ *
+ * @param socketPath Path of the unix domain socket
+ * @return The folder
+ */
+string socketFolder(const string & socketPath) {
+	string folder = std::filesystem::path(socketPath).parent_path().string();
+	return (folder.empty()) ? "." : folder;
+}
+
+/**
+ * Daemon sharing loaded dictionaries between the sessions of many users.
+ * Clients connect through a unix domain socket and talk in tab separated lines:
+ *
+ *   OPEN <dict> <option> <seed>  ->  DECK <vocNum>
+ *   NEXT                         ->  CARD <jaToEn> <en> <ja> <furi> <idx>  or  END
+ *   ANSWER <translations>        ->  GRADE <correct> <byReading> <remTrans> <corUTrans> <confusedWith> <confusedIdx>
+ *   STATS                        ->  STATS <sessions> <answered> <correct> <confusions>
+ *
+ * Any request may be answered with ERR <message>. Every dictionary is loaded once
+ * and shared read-only by all sessions, users are told apart by their uid.
+ */
+struct Daemon {
+	struct UserStats {
+		long sessions = 0;
+		long answered = 0;
+		long correct = 0;
+		std::set<std::tuple<string,int,int>> confusions; // dictionary and two vocabularies mixed up, lower index first
+	};
+
+	struct Client {
+		int fd;
+		uid_t uid;
+		string in; // received requests not answered yet
+		string out; // replies the socket did not take yet
+		Session session;
+		string deck; // name of the dictionary of the session
+		bool started = false;
+		bool closing = false; // the client sends no more requests
+	};
+
+	static const size_t maxRequest = 1 << 16; // longest request
+	static const size_t maxReplies = 1 << 16; // replies held for a client before its requests are no longer read
+
+	string dictsDir;
+	std::unordered_map<string, std::shared_ptr<const VocInfo>> decks;
+	std::unordered_map<uid_t, UserStats> users;
+	std::unordered_map<int, std::unique_ptr<Client>> clients;
+	int epollFd = -1;
+
+	/**
+	 * Answers a single request
+	 *
+	 * @param client The client that sent the request
+	 * @param line The request without line break
+	 * @return The reply without line break
+	 */
+	string handle(Client & client, const string & line) {
+		vector<string> fields = splitFields(line);
+		const string & type = fields[0];
+		UserStats & stats = users[client.uid];
+		try {
+			if ( (type == "OPEN") && (fields.size() == 4) ) {
+				const string & name = fields[1];
+				auto deck = decks.find(name);
+				if (deck == decks.end()) return "ERR\tUnknown dictionary \""+name+"\".";
+				int option = std::stoi(fields[2]);
+				if ( (option < 0) || (option > 2) ) return "ERR\tInvalid query option.";
+				client.session.start(deck->second, option, std::stoull(fields[3]));
+				client.deck = name;
+				client.started = true;
+				++stats.sessions;
+				return "DECK\t"+std::to_string(client.session.vocNum);
+			}
+			if (!client.started) return "ERR\tNo session opened.";
+			if (type == "NEXT") {
+				Card card;
+				if (!client.session.next(card)) return "END";
+				return string("CARD\t")+((card.jaToEn) ? "1" : "0")+"\t"+card.en+"\t"+card.ja+"\t"+card.furi+"\t"+std::to_string(client.session.idx);
+			}
+			if ( (type == "ANSWER") && (fields.size() == 2) ) {
+				int idx = client.session.idx;
+				if (idx == -1) return "ERR\tNo card to answer.";
+				Grade grade = client.session.grade(fields[1]);
+				if (grade.confusedIdx != -1) stats.confusions.emplace(client.deck, std::min(idx, grade.confusedIdx), std::max(idx, grade.confusedIdx));
+				string remainTrans;
+				for (int i=0;i<grade.remTrans.size();++i) (i==0) ? remainTrans += grade.remTrans[i] : remainTrans += ";"+grade.remTrans[i];
+				++stats.answered;
+				if (grade.correct) ++stats.correct;
+				return string("GRADE\t")+((grade.correct) ? "1" : "0")+"\t"+((grade.byReading) ? "1" : "0")+"\t"+remainTrans
+					+"\t"+std::to_string(client.session.corUTrans)+"\t"+grade.confusedWith+"\t"+std::to_string(grade.confusedIdx);
+			}
+			if (type == "STATS") {
+				return "STATS\t"+std::to_string(stats.sessions)+"\t"+std::to_string(stats.answered)+"\t"+std::to_string(stats.correct)
+					+"\t"+std::to_string(stats.confusions.size());
+			}
+		}
+		catch (const std::exception &) {} // malformed numbers
+		return "ERR\tInvalid request.";
+	}
+
+	void disconnect(int fd) {
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+		close(fd);
+		clients.erase(fd);
+	}
+
+	/* writes pending replies, false if the client can not be written to anymore */
+	bool flush(Client & client) {
+		while (!client.out.empty()) {
+			ssize_t n = write(client.fd, client.out.data(), client.out.size());
+			if ( (n == -1) && (errno == EAGAIN) ) break;
+			if (n <= 0) return false;
+			client.out.erase(0, n);
+		}
+		return true;
+	}
+
+	/* only reads requests while few replies are pending and waits for the socket to become writable if some are */
+	void watch(Client & client) {
+		epoll_event event = {};
+		event.events = (( client.closing || (client.out.size() >= maxReplies) ) ? 0 : EPOLLIN) | ((client.out.empty()) ? 0 : EPOLLOUT);
+		event.data.fd = client.fd;
+		epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &event);
+	}
+
+	void accept(int listener) {
+		int fd;
+		while ( (fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1 ) {
+			ucred cred = {};
+			socklen_t len = sizeof(cred);
+			getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len);
+			auto client = std::make_unique<Client>();
+			client->fd = fd;
+			client->uid = cred.uid;
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+			clients[fd] = std::move(client);
+		}
+	}
+
+	/* answers complete requests as long as the client reads its replies */
+	void process(Client & client) {
+		size_t start = 0, end;
+		while ( (client.out.size() < maxReplies) && ((end = client.in.find('\n', start)) != string::npos) ) {
+			client.out += handle(client, client.in.substr(start, end-start))+"\n";
+			start = end+1;
+		}
+		client.in.erase(0, start);
+	}
+
+	/* reads and answers requests of a client, false if it has to be disconnected */
+	bool receive(Client & client) {
+		char buf[4096];
+		while (client.out.size() < maxReplies) {
+			ssize_t n = read(client.fd, buf, sizeof(buf));
+			if (n == 0) client.closing = true;
+			if (n <= 0) return (n == 0) || (errno == EAGAIN);
+			client.in.append(buf, n);
+			process(client);
+			if ( (client.in.size() > maxRequest) && (client.in.find('\n') == string::npos) ) return false;
+		}
+		return true;
+	}
+
+	/* parses every dictionary up front, so that no request waits for a file to be read */
+	void loadDecks() {
+		std::error_code error;
+		for (const auto & entry : std::filesystem::directory_iterator(dictsDir, error)) {
+			string name = entry.path().filename().string();
+			if ( (!entry.is_regular_file()) || (name[0] == '.') ) continue;
+			try { decks[name] = std::make_shared<const VocInfo>(getVocs(entry.path().string())); }
+			catch (string message) { cerr << message << endl; } // sessions can not be opened on it
+		}
+		if (decks.empty()) throw "No dictionary found in \""+dictsDir+"\".";
+	}
+
+	/**
+	 * Serves clients until SIGINT or SIGTERM
+	 *
+	 * @param socketPath Path of the unix domain socket
+	 */
+	void run(const string & socketPath) {
+		sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		if (socketPath.size() >= sizeof(addr.sun_path)) throw "Socket path \""+socketPath+"\" is too long.";
+		strcpy(addr.sun_path, socketPath.c_str());
+
+		/* a socket nobody accepts on is left over from a daemon that did not exit cleanly */
+		int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		bool running = (connect(probe, (sockaddr *) &addr, sizeof(addr)) == 0);
+		close(probe);
+		if (running) throw "Another cursaryd is listening on \""+socketPath+"\".";
+
+		/* clients trust the socket because nobody but this account can put one into its folder */
+		string folder = socketFolder(socketPath);
+		if ( (mkdir(folder.c_str(), 0755) == -1) && (errno != EEXIST) ) throw "Could not create \""+folder+"\".";
+		struct stat info;
+		if ( (stat(folder.c_str(), &info) == -1) || (!S_ISDIR(info.st_mode)) || (info.st_uid != geteuid()) || (info.st_mode & (S_IWGRP | S_IWOTH)) ) {
+			throw "\""+folder+"\" has to be a folder of this account that other users can not write to.";
+		}
+		loadDecks();
+		unlink(socketPath.c_str());
+
+		int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if ( (bind(listener, (sockaddr *) &addr, sizeof(addr)) == -1) || (listen(listener, SOMAXCONN) == -1) ) {
+			throw "Could not listen on \""+socketPath+"\".";
+		}
+		chmod(socketPath.c_str(), 0666); // every user of the machine may connect
+
+		signal(SIGPIPE, SIG_IGN);
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		sigprocmask(SIG_BLOCK, &signals, nullptr);
+		int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+		epollFd = epoll_create1(EPOLL_CLOEXEC);
+		for (int fd : {listener, signalFd}) {
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.fd = fd;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+		}
+		cerr << "cursaryd listening on " << socketPath << endl;
+
+		bool stopping = false;
+		epoll_event events[64];
+		while (!stopping) {
+			int ready = epoll_wait(epollFd, events, 64, -1);
+			for (int i=0; i<ready; ++i) {
+				int fd = events[i].data.fd;
+				if (fd == listener) accept(listener);
+				else if (fd == signalFd) stopping = true;
+				else {
+					auto it = clients.find(fd);
+					if (it == clients.end()) continue;
+					Client & client = *it->second;
+					bool keep = ((events[i].events & (EPOLLERR | EPOLLHUP)) == 0) && flush(client);
+					if (keep) process(client); // requests held back until earlier replies were read
+					if ( keep && (events[i].events & EPOLLIN) ) keep = receive(client);
+					if (keep) keep = flush(client);
+					while ( keep && client.out.empty() && (client.in.find('\n') != string::npos) ) { // held back requests do not wake up epoll
+						process(client);
+						keep = flush(client);
+					}
+					if ( (!keep) || (client.closing && client.out.empty()) ) disconnect(fd);
+					else watch(client);
+				}
+			}
+		}
+
+		while (!clients.empty()) disconnect(clients.begin()->first);
+		close(listener);
+		close(signalFd);
+		close(epollFd);
+		unlink(socketPath.c_str());
+	}
+};
+
+/**
+ * Connects to cursaryd
+ *
+ * @param socketPath Path of the unix domain socket of cursaryd
+ * @return The connection
+ */
+int connectDaemon(const string & socketPath) {
+	sockaddr_un addr = {};
+	addr.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(addr.sun_path)) throw "Socket path \""+socketPath+"\" is too long.";
+	strcpy(addr.sun_path, socketPath.c_str());
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (connect(fd, (sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(fd);
+		throw "Could not connect to cursaryd on \""+socketPath+"\".";
+	}
+	/* anyone may listen on a path, only the owner of the folder or root are trusted with the answers */
+	ucred cred = {};
+	socklen_t len = sizeof(cred);
+	struct stat info;
+	string folder = socketFolder(socketPath);
+	if ( (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) || (stat(folder.c_str(), &info) == -1) || ((cred.uid != 0) && (cred.uid != info.st_uid)) ) {
+		close(fd);
+		throw "The server on \""+socketPath+"\" is not run by the owner of \""+folder+"\".";
+	}
+	return fd;
 }
 
 int main(int argc, char** argv) {
@@ -825,12 +3007,122 @@ int main(int argc, char** argv) {
 	string dictFile = dictSubDir+"enja.txt";
 	string dict = buffer + dictFile;
 
+	/* command line options */
+	string answersFile, outFile;
+	string corpusFile = buffer+string("/examples/sentences.tsv");
+	bool corpusGiven = false;
+	bool buildExamples = false;
+	string socketPath = "/run/cursaryd/cursaryd.sock";
+	string program = argv[0];
+	bool runDaemon = (program.substr(program.find_last_of('/')+1) == "cursaryd");
+	bool connectToDaemon = false;
+	bool asJson = false;
+	string importFile, format, fields = "gloss,kanji,reading";
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	sessionSeed = ((uint64_t) std::random_device{}() << 32) ^ std::random_device{}();
+	for (int i=1; i<argc; ++i) {
+		string arg = argv[i];
+		string val = (i+1<argc) ? argv[i+1] : "";
+		try {
+			if ( (arg == "--seed") && (i+1<argc) ) sessionSeed = std::stoull(argv[++i]);
+			else if ( (arg == "--dict") && (i+1<argc) ) {
+				++i;
+				dict = (std::filesystem::exists(val)) ? val : buffer+dictSubDir+val;
+			}
+			else if ( (arg == "--timed") && (i+1<argc) ) answerSeconds = std::max(0, std::stoi(argv[++i]));
+			else if ( (arg == "--drill") && (i+1<argc) ) drillSeconds = std::max(0, std::stoi(argv[++i]));
+			else if ( (arg == "--grade") && (i+1<argc) ) answersFile = argv[++i];
+			else if (arg == "--daemon") runDaemon = true;
+			else if (arg == "--connect") connectToDaemon = true;
+			else if ( (arg == "--socket") && (i+1<argc) ) socketPath = argv[++i];
+			else if ( (arg == "--examples") && (i+1<argc) ) {
+				corpusFile = argv[++i];
+				corpusGiven = true;
+			}
+			else if ( (arg == "--build-examples") && (i+1<argc) ) {
+				corpusFile = argv[++i];
+				buildExamples = true;
+			}
+			else if ( (arg == "--out") && (i+1<argc) ) outFile = argv[++i];
+			else if ( (arg == "--format") && ((val == "tsv") || (val == "json") || (val == "csv") || (val == "jmdict")) ) format = argv[++i];
+			else if ( (arg == "--import") && (i+1<argc) ) importFile = argv[++i];
+			else if ( (arg == "--fields") && (i+1<argc) ) fields = argv[++i];
+			else if ( (arg == "--threads") && (i+1<argc) ) threads = std::max(1, std::stoi(argv[++i]));
+			else throw std::invalid_argument(arg);
+		}
+		catch (const std::exception &) {
+			cerr << "Usage: " << argv[0] << " [--seed N] [--dict FILE] [--timed SECONDS] [--drill SECONDS] [--examples CORPUS] [--connect] [--socket PATH]" << endl;
+			cerr << "       " << argv[0] << " --grade ANSWERS --dict FILE [--format tsv|json] [--out FILE] [--threads N]" << endl;
+			cerr << "       " << argv[0] << " --build-examples CORPUS" << endl;
+			cerr << "       " << argv[0] << " --import FILE [--format jmdict|tsv|csv] [--fields kanji,reading,gloss,-] [--out FILE]" << endl;
+			cerr << "       " << argv[0] << " --daemon [--socket PATH]" << endl;
+			return -1;
+		}
+	}
+	/* --format is the result format of --grade and the input format of --import */
+	bool importing = (!runDaemon) && (!buildExamples) && (!importFile.empty());
+	bool grading = (!runDaemon) && (!buildExamples) && importFile.empty() && (!answersFile.empty());
+	if ( (!format.empty()) && (!( (importing && (format != "json")) || (grading && ((format == "tsv") || (format == "json"))) )) ) {
+		cerr << "--format " << format << " does not apply here: --grade writes tsv or json, --import reads jmdict, tsv or csv." << endl;
+		return -1;
+	}
+	asJson = (format == "json");
+	/* command line options */
+
+	if ( runDaemon || buildExamples || (!answersFile.empty()) || (!importFile.empty()) ) {
+		try {
+			if (runDaemon) {
+				Daemon daemon;
+				daemon.dictsDir = buffer+dictSubDir;
+				daemon.run(socketPath);
+			}
+			else if (buildExamples) buildExampleIndex(corpusFile);
+			else if (!importFile.empty()) {
+				bool overwrite = !outFile.empty(); // only files named explicitly are replaced
+				if (outFile.empty()) { // dictionary of the same name inside the dictionary folder
+					string name = importFile.substr(importFile.find_last_of('/')+1);
+					outFile = buffer+dictSubDir+name.substr(0, name.find_last_of('.'))+".txt";
+				}
+				importDict(importFile, outFile, format, fields, overwrite);
+			}
+			else gradeAnswers(answersFile, dict, outFile, asJson, threads);
+		}
+		catch (string message) {
+			cerr << message << endl;
+			return -1;
+		}
+		return 0;
+	}
+
+	if (connectToDaemon) {
+		/* cursaryd opens dictionaries by name from its own dictionary folder */
+		std::filesystem::path dictDir = std::filesystem::weakly_canonical(buffer+string("/dicts"));
+		if (std::filesystem::weakly_canonical(dict).parent_path() != dictDir) {
+			cerr << "With --connect only dictionaries inside " << dictDir.string() << " can be queried, not \"" << dict << "\"." << endl;
+			return -1;
+		}
+		try { daemonFd = connectDaemon(socketPath); }
+		catch (string message) {
+			cerr << message << endl;
+			return -1;
+		}
+	}
+
+	/* example sentences are optional unless a corpus was given */
+	string examplesError = exampleIndex.open(corpusFile);
+	if ( corpusGiven && (!examplesError.empty()) ) {
+		cerr << examplesError << endl;
+		return -1;
+	}
+
 	setlocale(LC_ALL, "");
 	initscr(); cbreak(); noecho(); nonl(); intrflush(stdscr, false); keypad(stdscr, true); curs_set(false);
+	set_escdelay(25); // escape clears menu filters, do not wait for escape sequences long
 
 	if (!has_colors()) throw "TERMINAL DOES NOT SUPPORT COLORS.";
 	try {
 			start_color();
+			events.init();
 			mkStartWin("Cursary: Your Friendly Neighborhood Voc Trainer", "Insert Coin");
 		while (true) {
 			char uOption = mkOptsWin(opt1,opt2,opt3,opt4,opt5);
@@ -842,10 +3134,12 @@ int main(int argc, char** argv) {
 
 	}
 	catch (string message) {
+		freeWindows();
 		endwin();
 		cerr << message << endl;
 		return -1;
 	}
+	freeWindows();
 	endwin();
 	return 0;
 }